@@ -0,0 +1,421 @@
+/**********************************************************************
+   NAME: SimpleBytes.hpp
+   AUTHOR: Johnathan Bizzano
+   DATE: 6/22/2023
+
+    The Simple Project
+		Medium Level (from Low) library that abstracts away from embedded device hardware
+
+    Simple Bytes
+		Bulk byte kernels (byte swapping) with SIMD fast paths (SSSE3/AVX2/NEON) and a portable scalar fallback
+		and the LEB128 varint/zigzag kernels of the compact encoding
+		and a delimiter scan (find any of a few bytes) for line/token parsing and a sync word search for framing
+*********************************************************************/
+
+#ifndef SIMPLE_BYTES_C_H
+#define SIMPLE_BYTES_C_H
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+
+#if defined(__AVX2__) || defined(__SSSE3__) || defined(__SSE2__) || defined(__BMI2__)
+    #include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #include <arm_neon.h>
+    #define SIMPLE_NEON
+#endif
+
+namespace Simple{
+
+    /**If the wire (big endian) order differs from the order of this machine**/
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    constexpr bool HostRequiresByteSwap = true;
+#else
+    constexpr bool HostRequiresByteSwap = false;
+#endif
+
+    namespace Internal{
+        template<typename T> inline T LoadRaw(const uint8_t* p){ T v; memcpy(&v, p, sizeof(T)); return v; }
+        template<typename T> inline void StoreRaw(uint8_t* p, T v){ memcpy(p, &v, sizeof(T)); }
+
+        inline uint8_t Swap(uint8_t v){ return v; }
+#if defined(__GNUC__) || defined(__clang__)
+        inline uint16_t Swap(uint16_t v){ return __builtin_bswap16(v); }
+        inline uint32_t Swap(uint32_t v){ return __builtin_bswap32(v); }
+        inline uint64_t Swap(uint64_t v){ return __builtin_bswap64(v); }
+#else
+        inline uint16_t Swap(uint16_t v){ return (uint16_t) ((v << 8) | (v >> 8)); }
+        inline uint32_t Swap(uint32_t v){ return (v << 24) | ((v << 8) & 0xFF0000) | ((v >> 8) & 0xFF00) | (v >> 24); }
+        inline uint64_t Swap(uint64_t v){ return ((uint64_t) Swap((uint32_t) v) << 32) | Swap((uint32_t) (v >> 32)); }
+#endif
+
+        /**Swap the tail (or everything when there is no SIMD) one element at a time**/
+        template<typename U> inline void SwapScalar(uint8_t* dst, const uint8_t* src, int count){
+            for(int i = 0; i < count; i++)
+                StoreRaw<U>(dst + i * sizeof(U), Swap(LoadRaw<U>(src + i * sizeof(U))));
+        }
+
+        /**Swap whole vectors of elements of width $S and return the number of elements handled**/
+        template<int S> inline int SwapVector(uint8_t* dst, const uint8_t* src, int count){
+            int i = 0;
+            const int bytes = count * S;
+            (void) bytes; (void) dst; (void) src;
+#if defined(__AVX2__)
+            const __m256i mask256 = S == 2 ? _mm256_setr_epi8(1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14, 1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14) :
+                                    S == 4 ? _mm256_setr_epi8(3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12, 3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12) :
+                                             _mm256_setr_epi8(7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8, 7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8);
+            for(; i + 32 <= bytes; i += 32)
+                _mm256_storeu_si256((__m256i*) (dst + i), _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*) (src + i)), mask256));
+#endif
+#if defined(__SSSE3__)
+            const __m128i mask128 = S == 2 ? _mm_setr_epi8(1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14) :
+                                    S == 4 ? _mm_setr_epi8(3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12) :
+                                             _mm_setr_epi8(7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8);
+            for(; i + 16 <= bytes; i += 16)
+                _mm_storeu_si128((__m128i*) (dst + i), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (src + i)), mask128));
+#elif defined(SIMPLE_NEON)
+            for(; i + 16 <= bytes; i += 16){
+                uint8x16_t v = vld1q_u8(src + i);
+                vst1q_u8(dst + i, S == 2 ? vrev16q_u8(v) : S == 4 ? vrev32q_u8(v) : vrev64q_u8(v));
+            }
+#endif
+            return i / S;
+        }
+
+        template<typename U> inline void SwapWidth(uint8_t* dst, const uint8_t* src, int count){
+            int done = SwapVector<sizeof(U)>(dst, src, count);
+            SwapScalar<U>(dst + done * sizeof(U), src + done * sizeof(U), count - done);
+        }
+    }
+
+    /**Copy $count elements of $size bytes from $src to $dst reversing the byte order of each element.
+     * $dst and $src may be the same memory (in place) but must not partially overlap**/
+    inline void SwapBytes(uint8_t* dst, const uint8_t* src, int count, int size){
+        switch(size){
+            case 1:
+                if(dst != src)
+                    memmove(dst, src, count);
+                break;
+            case 2: Internal::SwapWidth<uint16_t>(dst, src, count); break;
+            case 4: Internal::SwapWidth<uint32_t>(dst, src, count); break;
+            case 8: Internal::SwapWidth<uint64_t>(dst, src, count); break;
+            default:
+                for(int i = 0; i < count; i++, dst += size, src += size){
+                    if(dst != src)
+                        memmove(dst, src, size);
+                    std::reverse(dst, dst + size);
+                }
+                break;
+        }
+    }
+
+    namespace Internal{
+        template<int S> struct UIntOf{};
+        template<> struct UIntOf<1>{ using type = uint8_t; };
+        template<> struct UIntOf<2>{ using type = uint16_t; };
+        template<> struct UIntOf<4>{ using type = uint32_t; };
+        template<> struct UIntOf<8>{ using type = uint64_t; };
+
+        template<typename T, typename U = typename UIntOf<sizeof(T)>::type> inline void StoreStd(uint8_t* dst, T v, int){
+            U u;
+            memcpy(&u, &v, sizeof(T));
+            if(HostRequiresByteSwap)
+                u = Swap(u);
+            memcpy(dst, &u, sizeof(T));
+        }
+
+        template<typename T> inline void StoreStd(uint8_t* dst, T v, long){
+            memcpy(dst, &v, sizeof(T));
+            if(HostRequiresByteSwap)
+                std::reverse(dst, dst + sizeof(T));
+        }
+
+        template<typename T, typename U = typename UIntOf<sizeof(T)>::type> inline T LoadStd(const uint8_t* src, int){
+            U u;
+            memcpy(&u, src, sizeof(T));
+            if(HostRequiresByteSwap)
+                u = Swap(u);
+            T v;
+            memcpy(&v, &u, sizeof(T));
+            return v;
+        }
+
+        template<typename T> inline T LoadStd(const uint8_t* src, long){
+            T v;
+            auto p = (uint8_t*) &v;
+            memcpy(p, src, sizeof(T));
+            if(HostRequiresByteSwap)
+                std::reverse(p, p + sizeof(T));
+            return v;
+        }
+    }
+
+    /**Store the arithmetic value $v at $dst in wire (big endian) order**/
+    template<typename T> inline void StoreStd(uint8_t* dst, T v){ Internal::StoreStd<T>(dst, v, 0); }
+
+    /**Load an arithmetic value in wire (big endian) order from $src**/
+    template<typename T> inline T LoadStd(const uint8_t* src){ return Internal::LoadStd<T>(src, 0); }
+
+    /**Most bytes a 64 bit varint takes**/
+    constexpr int MaxVarintBytes = 10;
+
+    /**Map signed values to unsigned so small magnitudes of either sign stay small (0, -1, 1, -2 -> 0, 1, 2, 3)**/
+    inline uint64_t ZigZag(int64_t v){ return ((uint64_t) v << 1) ^ (uint64_t) (v >> 63); }
+    inline int64_t UnZigZag(uint64_t v){ return (int64_t) (v >> 1) ^ -(int64_t) (v & 1); }
+
+    /**Bytes $v takes as a varint**/
+    inline int VarintSize(uint64_t v){
+        int n = 1;
+        while(v >= 0x80){
+            v >>= 7;
+            n++;
+        }
+        return n;
+    }
+
+    /**Write $v to $dst as a LEB128 varint (7 bits per byte, low first, high bit set on all but the last). Return the bytes written**/
+    inline int EncodeVarint(uint8_t* dst, uint64_t v){
+        int n = 0;
+        while(v >= 0x80){
+            dst[n++] = (uint8_t) (v | 0x80);
+            v >>= 7;
+        }
+        dst[n++] = (uint8_t) v;
+        return n;
+    }
+
+    /**Decode a varint from the $length bytes at $src. Return the bytes used or 0 if it is incomplete or too long.
+     * 1-2 byte values take a branch. Longer ones (with 8 readable bytes) are found with one load and a bit scan and their groups
+     * are packed together with PEXT (BMI2) or three shift-and-mask steps instead of a loop**/
+    inline int DecodeVarint(const uint8_t* src, int length, uint64_t* v){
+        if(length >= 2 && src[1] < 0x80){                               //1 and 2 byte values are the common case, keep them on a predicted branch
+            if(src[0] < 0x80){
+                *v = src[0];
+                return 1;
+            }
+            *v = (src[0] & 0x7F) | ((uint64_t) src[1] << 7);
+            return 2;
+        }
+#if defined(__GNUC__) || defined(__clang__)
+        if(length >= 8){
+            auto word = Internal::LoadRaw<uint64_t>(src);
+            if(!HostRequiresByteSwap)
+                word = Internal::Swap(word);                                //Wire byte 0 in the low bits
+            auto stops = ~word & 0x8080808080808080ULL;
+            if(stops != 0){
+                word &= stops ^ (stops - 1);                                //Keep the bytes up to the last one
+#if defined(__BMI2__)
+                *v = _pext_u64(word, 0x7F7F7F7F7F7F7F7FULL);
+#else
+                word &= 0x7F7F7F7F7F7F7F7FULL;
+                word = (word & 0x007F007F007F007FULL) | ((word & 0x7F007F007F007F00ULL) >> 1);
+                word = (word & 0x00003FFF00003FFFULL) | ((word & 0x3FFF00003FFF0000ULL) >> 2);
+                word = (word & 0x000000000FFFFFFFULL) | ((word & 0x0FFFFFFF00000000ULL) >> 4);
+                *v = word;
+#endif
+                return (__builtin_ctzll(stops) >> 3) + 1;
+            }
+        }
+#endif
+        uint64_t result = 0;
+        for(int i = 0; i < length && i < MaxVarintBytes; i++){
+            result |= (uint64_t) (src[i] & 0x7F) << (7 * i);
+            if(!(src[i] & 0x80)){
+                *v = result;
+                return i + 1;
+            }
+        }
+        return 0;
+    }
+
+    namespace Internal{
+        inline bool IsAnyOf(uint8_t c, const uint8_t* stops, int count){
+            for(int i = 0; i < count; i++)
+                if(c == stops[i])
+                    return true;
+            return false;
+        }
+
+        inline int LowestBit(uint64_t m){
+#if defined(__GNUC__) || defined(__clang__)
+            return __builtin_ctzll(m);
+#else
+            int n = 0;
+            while(!(m & 1)){
+                m >>= 1;
+                n++;
+            }
+            return n;
+#endif
+        }
+
+        /**Scan whole vectors for any of up to 4 stop bytes. Return the index of the first match, or where the scalar tail has to start
+         * (with $found false)**/
+        inline int FindAnyVector(const uint8_t* src, int length, const uint8_t* stops, int count, bool* found){
+            int i = 0;
+            *found = false;
+            (void) src; (void) stops; (void) count;
+            if(count > 4)
+                return 0;
+#if defined(__AVX2__)
+            __m256i s256[4];
+            for(int k = 0; k < 4; k++)
+                s256[k] = _mm256_set1_epi8((char) stops[k < count ? k : 0]);
+            for(; i + 32 <= length; i += 32){
+                auto v = _mm256_loadu_si256((const __m256i*) (src + i));
+                auto eq = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, s256[0]), _mm256_cmpeq_epi8(v, s256[1])),
+                                          _mm256_or_si256(_mm256_cmpeq_epi8(v, s256[2]), _mm256_cmpeq_epi8(v, s256[3])));
+                auto m = (uint32_t) _mm256_movemask_epi8(eq);
+                if(m != 0){
+                    *found = true;
+                    return i + LowestBit(m);
+                }
+            }
+#endif
+#if defined(__SSE2__)
+            __m128i s128[4];
+            for(int k = 0; k < 4; k++)
+                s128[k] = _mm_set1_epi8((char) stops[k < count ? k : 0]);
+            for(; i + 16 <= length; i += 16){
+                auto v = _mm_loadu_si128((const __m128i*) (src + i));
+                auto eq = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, s128[0]), _mm_cmpeq_epi8(v, s128[1])),
+                                       _mm_or_si128(_mm_cmpeq_epi8(v, s128[2]), _mm_cmpeq_epi8(v, s128[3])));
+                auto m = (uint32_t) _mm_movemask_epi8(eq);
+                if(m != 0){
+                    *found = true;
+                    return i + LowestBit(m);
+                }
+            }
+#elif defined(SIMPLE_NEON)
+            uint8x16_t s128[4];
+            for(int k = 0; k < 4; k++)
+                s128[k] = vdupq_n_u8(stops[k < count ? k : 0]);
+            for(; i + 16 <= length; i += 16){
+                auto v = vld1q_u8(src + i);
+                auto eq = vorrq_u8(vorrq_u8(vceqq_u8(v, s128[0]), vceqq_u8(v, s128[1])), vorrq_u8(vceqq_u8(v, s128[2]), vceqq_u8(v, s128[3])));
+                //Narrow every byte of the compare mask to a nibble so the first match is a bit scan
+                auto m = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+                if(m != 0){
+                    *found = true;
+                    return i + (LowestBit(m) >> 2);
+                }
+            }
+#endif
+            return i;
+        }
+    }
+
+    /**Index of the first of the $length bytes at $src that is one of the $count bytes at $stops, or $length when there is none.
+     * One stop byte is a memchr. Up to 4 are compared 16/32 bytes at a time (SSE2/AVX2/NEON), more are checked byte by byte**/
+    inline int FindAny(const uint8_t* src, int length, const uint8_t* stops, int count){
+        if(length <= 0 || count <= 0)
+            return std::max(length, 0);
+        if(count == 1){
+            auto p = (const uint8_t*) memchr(src, stops[0], length);
+            return p != nullptr ? (int) (p - src) : length;
+        }
+        bool found;
+        int i = Internal::FindAnyVector(src, length, stops, count, &found);
+        if(found)
+            return i;
+        while(i < length && !Internal::IsAnyOf(src[i], stops, count))
+            i++;
+        return i;
+    }
+
+    namespace Internal{
+        /**If the $count byte $word starts at $src, where only $length bytes are readable (a match that runs off the end counts)**/
+        inline bool StartsWord(const uint8_t* src, int length, const uint8_t* word, int count){
+            return memcmp(src, word, std::min(count, length)) == 0;
+        }
+
+        /**Scan whole vectors for positions where the first two bytes of $word line up and check those candidates. Random data
+         * rarely has both, so the full compare seldom runs. Return the index of the match, or where the scalar tail has to start
+         * (with $found false)**/
+        inline int FindWordVector(const uint8_t* src, int length, const uint8_t* word, int count, bool* found){
+            int i = 0;
+            *found = false;
+            (void) src; (void) word; (void) count;
+#if defined(__AVX2__)
+            const __m256i first256 = _mm256_set1_epi8((char) word[0]), second256 = _mm256_set1_epi8((char) word[1]);
+            for(; i + 33 <= length; i += 32){
+                auto eq = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*) (src + i)), first256),
+                                           _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*) (src + i + 1)), second256));
+                for(auto m = (uint32_t) _mm256_movemask_epi8(eq); m != 0; m &= m - 1){
+                    int k = i + LowestBit(m);
+                    if(StartsWord(src + k, length - k, word, count)){
+                        *found = true;
+                        return k;
+                    }
+                }
+            }
+#endif
+#if defined(__SSE2__)
+            const __m128i first128 = _mm_set1_epi8((char) word[0]), second128 = _mm_set1_epi8((char) word[1]);
+            for(; i + 17 <= length; i += 16){
+                auto eq = _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (src + i)), first128),
+                                        _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (src + i + 1)), second128));
+                for(auto m = (uint32_t) _mm_movemask_epi8(eq); m != 0; m &= m - 1){
+                    int k = i + LowestBit(m);
+                    if(StartsWord(src + k, length - k, word, count)){
+                        *found = true;
+                        return k;
+                    }
+                }
+            }
+#elif defined(SIMPLE_NEON)
+            const uint8x16_t first128 = vdupq_n_u8(word[0]), second128 = vdupq_n_u8(word[1]);
+            for(; i + 17 <= length; i += 16){
+                auto eq = vandq_u8(vceqq_u8(vld1q_u8(src + i), first128), vceqq_u8(vld1q_u8(src + i + 1), second128));
+                auto m = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+                for(; m != 0; m &= ~(0xFULL << (LowestBit(m) & ~3))){
+                    int k = i + (LowestBit(m) >> 2);
+                    if(StartsWord(src + k, length - k, word, count)){
+                        *found = true;
+                        return k;
+                    }
+                }
+            }
+#endif
+            return i;
+        }
+    }
+
+    /**Position of the first occurrence of the $count byte $word (a sync word) in the $length bytes at $src, or $length when there
+     * is none. A match that is cut off by the end of the bytes counts, so a word split between two reads is not skipped.
+     * Candidates are found with a two byte SIMD compare (SSE2/AVX2/NEON), otherwise with memchr on the first byte**/
+    inline int FindWord(const uint8_t* src, int length, const uint8_t* word, int count){
+        if(length <= 0 || count <= 0)
+            return std::max(length, 0);
+        int i = 0;
+        if(count >= 2){
+            bool found;
+            i = Internal::FindWordVector(src, length, word, count, &found);
+            if(found)
+                return i;
+        }
+        while(i < length){
+            auto p = (const uint8_t*) memchr(src + i, word[0], length - i);
+            if(p == nullptr)
+                return length;
+            i = (int) (p - src);
+            if(Internal::StartsWord(p, length - i, word, count))
+                return i;
+            i++;
+        }
+        return length;
+    }
+
+    /**Copy $count elements of $size bytes from native order at $src to wire order at $dst. Skips the swap on big endian machines**/
+    inline void ToStdBytes(uint8_t* dst, const uint8_t* src, int count, int size){
+        if(HostRequiresByteSwap)
+            SwapBytes(dst, src, count, size);
+        else if(dst != src)
+            memmove(dst, src, count * size);
+    }
+}
+
+#endif
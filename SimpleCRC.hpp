@@ -0,0 +1,180 @@
+/**********************************************************************
+   NAME: SimpleCRC.hpp
+   AUTHOR: Johnathan Bizzano
+   DATE: 6/22/2023
+
+    The Simple Project
+		Medium Level (from Low) library that abstracts away from embedded device hardware
+
+    Simple CRC
+		Incremental checksums for frame integrity. CRC32C uses the crc32 instruction (SSE4.2 / ARMv8 CRC)
+		when the target has it and slicing-by-8 tables otherwise. CRC16 (CCITT, slicing-by-8) halves the overhead of tiny frames
+*********************************************************************/
+
+#ifndef SIMPLE_CRC_C_H
+#define SIMPLE_CRC_C_H
+
+#include <stdint.h>
+#include "SimpleBytes.hpp"
+
+#if defined(__SSE4_2__)
+    #include <nmmintrin.h>
+#endif
+
+#if defined(__ARM_FEATURE_CRC32)
+    #include <arm_acle.h>
+#endif
+
+namespace Simple{
+    namespace Internal{
+        /**Slicing-by-8 tables of the reflected CRC32C (Castagnoli) polynomial. Built once on first use (8 KB)**/
+        struct CRC32CTables{
+            uint32_t t[8][256];
+
+            CRC32CTables(){
+                for(uint32_t i = 0; i < 256; i++){
+                    uint32_t c = i;
+                    for(int k = 0; k < 8; k++)
+                        c = (c >> 1) ^ (0x82F63B78 & (0 - (c & 1)));
+                    t[0][i] = c;
+                }
+                for(int s = 1; s < 8; s++)
+                    for(int i = 0; i < 256; i++)
+                        t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xFF];
+            }
+
+            static const CRC32CTables& Get(){
+                static CRC32CTables tables;
+                return tables;
+            }
+        };
+
+        /**Slicing-by-8 tables of the CRC16 CCITT polynomial (0x1021, not reflected). Built once on first use (4 KB)**/
+        struct CRC16Tables{
+            uint16_t t[8][256];
+
+            CRC16Tables(){
+                for(int i = 0; i < 256; i++){
+                    uint16_t c = (uint16_t) (i << 8);
+                    for(int k = 0; k < 8; k++)
+                        c = (uint16_t) ((c << 1) ^ (c & 0x8000 ? 0x1021 : 0));
+                    t[0][i] = c;
+                }
+                for(int s = 1; s < 8; s++)
+                    for(int i = 0; i < 256; i++)
+                        t[s][i] = (uint16_t) ((t[s - 1][i] << 8) ^ t[0][t[s - 1][i] >> 8]);
+            }
+
+            static const CRC16Tables& Get(){
+                static CRC16Tables tables;
+                return tables;
+            }
+        };
+
+        inline uint32_t CRC32CSoftware(uint32_t crc, const uint8_t* data, int length){
+            auto& t = CRC32CTables::Get().t;
+            for(; length >= 8; data += 8, length -= 8){
+                auto lo = crc ^ ((uint32_t) data[0] | (uint32_t) data[1] << 8 | (uint32_t) data[2] << 16 | (uint32_t) data[3] << 24);
+                crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+                      t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+            }
+            for(; length > 0; data++, length--)
+                crc = (crc >> 8) ^ t[0][(crc ^ *data) & 0xFF];
+            return crc;
+        }
+
+#if defined(__SSE4_2__)
+        inline uint32_t CRC32CHardware(uint32_t crc, const uint8_t* data, int length){
+    #if defined(__x86_64__) || defined(_M_X64)
+            uint64_t c = crc;
+            for(; length >= 8; data += 8, length -= 8)
+                c = _mm_crc32_u64(c, LoadRaw<uint64_t>(data));
+            crc = (uint32_t) c;
+    #endif
+            for(; length >= 4; data += 4, length -= 4)
+                crc = _mm_crc32_u32(crc, LoadRaw<uint32_t>(data));
+            for(; length > 0; data++, length--)
+                crc = _mm_crc32_u8(crc, *data);
+            return crc;
+        }
+#elif defined(__ARM_FEATURE_CRC32)
+        inline uint32_t CRC32CHardware(uint32_t crc, const uint8_t* data, int length){
+    #if defined(__aarch64__)
+            for(; length >= 8; data += 8, length -= 8)
+                crc = __crc32cd(crc, LoadRaw<uint64_t>(data));
+    #endif
+            for(; length >= 4; data += 4, length -= 4)
+                crc = __crc32cw(crc, LoadRaw<uint32_t>(data));
+            for(; length > 0; data++, length--)
+                crc = __crc32cb(crc, *data);
+            return crc;
+        }
+#endif
+    }
+
+    /**CRC32C (Castagnoli) that can be fed in pieces as the bytes arrive
+     *  CRC32C crc;
+     *  crc.Update(header, 5);
+     *  crc.Update(payload, length);
+     *  uint32_t check = crc.Value();
+     * **/
+    struct CRC32C{
+    private:
+        uint32_t crc = 0xFFFFFFFF;
+    public:
+        /**Bytes the checksum takes in a frame**/
+        static constexpr int Size = 4;
+
+        void Update(const uint8_t* data, int length){
+            if(length <= 0)
+                return;
+#if defined(__SSE4_2__) || defined(__ARM_FEATURE_CRC32)
+            crc = Internal::CRC32CHardware(crc, data, length);
+#else
+            crc = Internal::CRC32CSoftware(crc, data, length);
+#endif
+        }
+
+        inline uint32_t Value() const { return ~crc; }
+        inline void Reset(){ crc = 0xFFFFFFFF; }
+
+        /**The checksum of the $length bytes at $data**/
+        static uint32_t Compute(const uint8_t* data, int length){
+            CRC32C c;
+            c.Update(data, length);
+            return c.Value();
+        }
+    };
+
+    /**CRC16 CCITT (0x1021, starts at 0xFFFF) that can be fed in pieces. Half the frame overhead of CRC32C for short frames**/
+    struct CRC16{
+    private:
+        uint16_t crc = 0xFFFF;
+    public:
+        /**Bytes the checksum takes in a frame**/
+        static constexpr int Size = 2;
+
+        void Update(const uint8_t* data, int length){
+            auto& t = Internal::CRC16Tables::Get().t;
+            for(; length >= 8; data += 8, length -= 8){
+                auto c = crc ^ ((data[0] << 8) | data[1]);
+                crc = (uint16_t) (t[7][c >> 8] ^ t[6][c & 0xFF] ^ t[5][data[2]] ^ t[4][data[3]] ^
+                                  t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]]);
+            }
+            for(; length > 0; data++, length--)
+                crc = (uint16_t) ((crc << 8) ^ t[0][(crc >> 8) ^ *data]);
+        }
+
+        inline uint16_t Value() const { return crc; }
+        inline void Reset(){ crc = 0xFFFF; }
+
+        /**The checksum of the $length bytes at $data**/
+        static uint16_t Compute(const uint8_t* data, int length){
+            CRC16 c;
+            c.Update(data, length);
+            return c.Value();
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,230 @@
+/**********************************************************************
+   NAME: SimpleCompress.hpp
+   AUTHOR: Johnathan Bizzano
+   DATE: 6/22/2023
+
+    The Simple Project
+		Medium Level (from Low) library that abstracts away from embedded device hardware
+
+    Simple Compress
+		LZ4 block format compression for small payloads. Fixed working memory (4 KB, no heap) and an optional
+		preset dictionary that both ends share, so short repetitive messages (telemetry) compress too
+*********************************************************************/
+
+#ifndef SIMPLE_COMPRESS_C_H
+#define SIMPLE_COMPRESS_C_H
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include "SimpleBytes.hpp"
+
+namespace Simple{
+    /**Compresses and decompresses LZ4 blocks. A preset dictionary acts as data that came before every block, so matches
+     * can point into it. Both ends have to use the same dictionary (the bytes, not a copy of them, have to stay alive)
+     * Use it like this
+     *  Compressor lz(dictionary, sizeof(dictionary));
+     *  int n = lz.Compress(src, length, dst, length - 1);     //0 when it would not get smaller
+     *  int m = lz.Decompress(dst, n, out, capacity);         //-1 when the block is broken or does not fit
+     * **/
+    struct Compressor{
+        static constexpr int HashBits = 10;
+        static constexpr int MinMatch = 4;
+        /**Bytes of dictionary and block that matches can span (offsets are 16 bits)**/
+        static constexpr int Window = 0xFFFF;
+        /**Largest dictionary used (its end is kept), leaving the rest of the window to the blocks**/
+        static constexpr int MaxDictionary = Window / 2;
+
+    private:
+        static constexpr int HashSize = 1 << HashBits;
+        static constexpr int LastLiterals = 5;      //The block ends with literals
+        static constexpr int MatchLimit = 12;       //No match starts this close to the end
+
+        uint16_t table[HashSize];
+        uint16_t dictionary_table[HashSize];
+        const uint8_t* dictionary = nullptr;
+        int dictionary_length = 0;
+
+        static inline uint32_t Hash(const uint8_t* p){ return (Internal::LoadRaw<uint32_t>(p) * 2654435761U) >> (32 - HashBits); }
+
+        /**Equal bytes of $a and $b before $a_end or $b_end**/
+        static int Count(const uint8_t* a, const uint8_t* a_end, const uint8_t* b, const uint8_t* b_end){
+            auto start = a;
+            while(a + 8 <= a_end && b + 8 <= b_end && Internal::LoadRaw<uint64_t>(a) == Internal::LoadRaw<uint64_t>(b)){
+                a += 8;
+                b += 8;
+            }
+            while(a < a_end && b < b_end && *a == *b){
+                a++;
+                b++;
+            }
+            return (int) (a - start);
+        }
+
+        /**Write the rest of a literal or match length that did not fit in the token (it was 15 or more)**/
+        static uint8_t* WriteLength(uint8_t* dst, int n){
+            for(n -= 15; n >= 255; n -= 255)
+                *dst++ = 255;
+            *dst++ = (uint8_t) n;
+            return dst;
+        }
+
+        static bool ReadLength(const uint8_t** src, const uint8_t* end, size_t* n){
+            uint8_t b;
+            do{
+                if(*src >= end)
+                    return false;
+                b = *(*src)++;
+                *n += b;
+            }while(b == 255);
+            return true;
+        }
+
+    public:
+        Compressor(){ SetDictionary(nullptr, 0); }
+        Compressor(const uint8_t* dictionary, int length){ SetDictionary(dictionary, length); }
+
+        /**Use $length bytes at $dictionary (nullptr for none) as what comes before every block. Only its last MaxDictionary
+         * bytes are used. It is indexed once here, so each block only copies the index**/
+        void SetDictionary(const uint8_t* dictionary, int length){
+            if(dictionary == nullptr || length < MinMatch)
+                length = 0;
+            if(length > MaxDictionary){
+                dictionary += length - MaxDictionary;
+                length = MaxDictionary;
+            }
+            this->dictionary = dictionary;
+            dictionary_length = length;
+            memset(dictionary_table, 0, sizeof(dictionary_table));
+            for(int i = 0; i + MinMatch <= length; i++)
+                dictionary_table[Hash(dictionary + i)] = (uint16_t) i;
+        }
+
+        inline int DictionaryLength() const { return dictionary_length; }
+
+        /**Largest block $length bytes can compress to (incompressible data)**/
+        static constexpr int Bound(int length){ return length + length / 255 + 16; }
+
+        /**Compress $length bytes at $src into at most $capacity bytes at $dst. Return the size of the block, or 0 when it does not fit
+         * (pass $length - 1 to only accept a smaller result) or the dictionary and the data span more than the window**/
+        int Compress(const uint8_t* src, int length, uint8_t* dst, int capacity){
+            if(length <= 0 || dictionary_length + length > Window)
+                return 0;
+            memcpy(table, dictionary_table, sizeof(table));
+            auto end = src + length;
+            auto out = dst, out_end = dst + capacity;
+            auto ip = src, anchor = src;
+            auto dictionary_end = dictionary + dictionary_length;
+
+            if(length > MatchLimit){
+                auto limit = end - MatchLimit, match_end = end - LastLiterals;
+                while(ip < limit){
+                    int pos = dictionary_length + (int) (ip - src);
+                    auto h = Hash(ip);
+                    int candidate = table[h];
+                    table[h] = (uint16_t) pos;
+                    auto in_dictionary = candidate < dictionary_length;
+                    auto match = in_dictionary ? dictionary + candidate : src + (candidate - dictionary_length);
+                    if(candidate >= pos || Internal::LoadRaw<uint32_t>(match) != Internal::LoadRaw<uint32_t>(ip)){
+                        ip += 1 + ((ip - anchor) >> 6);     //Step faster through data that does not compress
+                        continue;
+                    }
+                    auto offset = pos - candidate;
+
+                    //Extend the match backwards into the pending literals, then forwards (out of the dictionary into the block)
+                    auto lowest = in_dictionary ? dictionary : src;
+                    while(ip > anchor && match > lowest && ip[-1] == match[-1]){
+                        ip--;
+                        match--;
+                    }
+                    int n = MinMatch;
+                    if(in_dictionary){
+                        n += Count(ip + n, match_end, match + n, dictionary_end);
+                        if(match + n == dictionary_end)
+                            n += Count(ip + n, match_end, src, end);
+                    }else
+                        n += Count(ip + n, match_end, match + n, end);
+
+                    int literals = (int) (ip - anchor);
+                    if(out + 1 + literals / 255 + 1 + literals + 2 + (n - MinMatch) / 255 + 1 > out_end)
+                        return 0;
+                    auto token = out++;
+                    *token = (uint8_t) (std::min(literals, 15) << 4);
+                    if(literals >= 15)
+                        out = WriteLength(out, literals);
+                    memcpy(out, anchor, literals);
+                    out += literals;
+                    *out++ = (uint8_t) offset;
+                    *out++ = (uint8_t) (offset >> 8);
+                    *token |= (uint8_t) std::min(n - MinMatch, 15);
+                    if(n - MinMatch >= 15)
+                        out = WriteLength(out, n - MinMatch);
+
+                    ip += n;
+                    anchor = ip;
+                    if(ip < limit)
+                        table[Hash(ip - 2)] = (uint16_t) (dictionary_length + (int) (ip - 2 - src));
+                }
+            }
+
+            int literals = (int) (end - anchor);
+            if(out + 1 + literals / 255 + 1 + literals > out_end)
+                return 0;
+            auto token = out++;
+            *token = (uint8_t) (std::min(literals, 15) << 4);
+            if(literals >= 15)
+                out = WriteLength(out, literals);
+            memcpy(out, anchor, literals);
+            return (int) (out + literals - dst);
+        }
+
+        /**Decompress the $length byte block at $src into at most $capacity bytes at $dst. Return the decompressed size, or -1 when
+         * the block is broken or does not fit. Never reads or writes out of the buffers, whatever the block holds**/
+        int Decompress(const uint8_t* src, int length, uint8_t* dst, int capacity) const {
+            auto end = src + length;
+            auto op = dst, op_end = dst + capacity;
+            while(src < end){
+                auto token = *src++;
+                size_t literals = token >> 4;
+                if(literals == 15 && !ReadLength(&src, end, &literals))
+                    return -1;
+                if(literals > (size_t) (end - src) || literals > (size_t) (op_end - op))
+                    return -1;
+                memcpy(op, src, literals);
+                src += literals;
+                op += literals;
+                if(src == end)
+                    break;                  //The last sequence has no match
+
+                if(end - src < 2)
+                    return -1;
+                size_t offset = src[0] | (src[1] << 8);
+                src += 2;
+                size_t n = token & 15;
+                if(n == 15 && !ReadLength(&src, end, &n))
+                    return -1;
+                n += MinMatch;
+                auto written = (size_t) (op - dst);
+                if(offset == 0 || offset > written + dictionary_length || n > (size_t) (op_end - op))
+                    return -1;
+                if(offset > written){
+                    auto back = offset - written;       //The match starts in the dictionary
+                    auto k = std::min(back, n);
+                    memcpy(op, dictionary + dictionary_length - back, k);
+                    op += k;
+                    n -= k;
+                }
+                auto match = op - offset;
+                if(offset >= n)
+                    memcpy(op, match, n);
+                else
+                    for(size_t i = 0; i < n; i++)
+                        op[i] = match[i];       //Overlapping copy repeats the last $offset bytes
+                op += n;
+            }
+            return (int) (op - dst);
+        }
+    };
+}
+
+#endif
@@ -21,6 +21,9 @@
 #include "SimpleTimer.hpp"
 #include "SimpleIO.hpp"
 #include "SimpleLock.hpp"
+#include "SimpleCRC.hpp"
+#include "SimpleCompress.hpp"
+#include <climits>
 #include <numeric>
 #include <vector>
 
@@ -28,10 +31,18 @@
 const uint32_t MAGIC_NUMBER = 0xDEADBEEF; //PACK in bytes
 //[238]
 const uint8_t TAIL_MAGIC_NUMBER = 0xEE;
+//[236] Tail of a frame whose payload is compressed
+const uint8_t TAIL_COMPRESSED_MAGIC_NUMBER = 0xEC;
+//[234] Tail of a frame that holds several coalesced messages
+const uint8_t TAIL_BATCH_MAGIC_NUMBER = 0xEA;
+//[232] Tail of a frame of coalesced messages that is compressed
+const uint8_t TAIL_COMPRESSED_BATCH_MAGIC_NUMBER = 0xE8;
 
 namespace Simple {
     struct Packet : public IOArray{
         explicit Packet(int capacity = 256) : IOArray(capacity){}
+        Packet(ref<uint8_t> heap_ref, int capacity, int size = 0) : IOArray(std::move(heap_ref), capacity, size){}
+        explicit Packet(const IOArray& view) : IOArray(view){}
 
         void config(bool reset = true){
             if(reset)
@@ -39,72 +50,521 @@ namespace Simple {
         }
     };
 
+    /**Packets on recycled buffers. Creating a packet per message this way does not touch the heap and the buffer goes back to the
+     * pool when the packet and every copy or slice of it are gone
+     * Use it like this
+     *  PacketPool pool(16, 256);
+     *  Packet p(pool.Take(256));     //From the pool, or the heap when it is exhausted
+     *  if(pool.Acquire(&p)){ ... }   //Only from the pool
+     * **/
+    struct PacketPool : public BufferPool{
+        PacketPool(int count, size_t buffer_size) : BufferPool(count, buffer_size){}
+        PacketPool(uint8_t* memory, int count, size_t buffer_size) : BufferPool(memory, count, buffer_size){}
+
+        using BufferPool::Acquire;
+
+        /**Point $p at an empty packet on a free buffer. Return false (leaving $p alone) when they are all in use**/
+        bool Acquire(Packet* p){
+            auto buffer = Acquire();
+            if(buffer == nullptr)
+                return false;
+            *p = Packet(std::move(buffer), BufferSize());
+            return true;
+        }
+
+        /**A packet on a free buffer, or on the heap with $fallback_capacity when they are all in use**/
+        Packet Take(int fallback_capacity){
+            auto buffer = Acquire();
+            return buffer != nullptr ? Packet(std::move(buffer), BufferSize()) : Packet(fallback_capacity);
+        }
+    };
+
     class Connection : public Task{
     public:
         virtual void Write(IO* p) = 0;
+        /**Write several buffers as one message without joining them. Override it when the port can gather**/
+        virtual void WriteV(const Span* parts, int count){
+            GatherIO io(parts, count);
+            Write(&io);
+        }
         virtual void Send(Packet* p){ Write(p); }
         virtual void Receive(Packet* p) = 0;
         TaskReturn Fire() override { return TaskReturn::Nothing; }
     };
 
+    /**Checksum of the length and payload that goes in front of the tail of every frame. The value is its size in bytes.
+     * Both ends of a connection have to use the same one**/
+    enum class FrameCheck : uint8_t { None = 0, CRC16 = Simple::CRC16::Size, CRC32C = Simple::CRC32C::Size };
+
+    /**How the payload length is written after the magic number. The value is its size in bytes (Varint takes 1-5).
+     * Byte is the original format (payloads up to 255 bytes). Both ends of a connection have to use the same one**/
+    enum class FrameLength : uint8_t { Varint = 0, Byte = 1, Short = 2, Int = 4 };
+
     class SimpleConnection : public Connection{
-        IOArray write_buffer;
-        Packet read_buffer;
+        RingIO read_buffer;
+        FrameCheck check;
+        FrameLength length_field;
+        size_t junk = 0, corrupt = 0, truncated = 0;
+        IOVector batch;
+        Timer flush_timer;
+        int batch_threshold = 0;
+        PacketPool* pool = nullptr;
+        Compressor* compressor = nullptr;
+        IOArray deflated, inflated;
+
+        enum class ParseState : uint8_t { Sync, Length, Body };
+        ParseState state = ParseState::Sync;
+        uint32_t frame_length = 0;
+        size_t payload_start = 0;
     public:
 
-        explicit SimpleConnection(int capacity = 256) : write_buffer(capacity), read_buffer(capacity){}
+        /**$capacity bounds the largest frame that can be received (see MaxPayload)**/
+        explicit SimpleConnection(int capacity = 256, FrameCheck check = FrameCheck::None, FrameLength length_field = FrameLength::Byte)
+            : read_buffer(capacity), check(check), length_field(length_field), deflated(nullptr, 0), inflated(nullptr, 0){}
 
+        /**Frame the packet (magic number, length, payload, checksum, tail) and write it as three segments. The payload is never copied.
+         * Payloads longer than the length field can hold are cut off (see TruncatedMessages). When coalescing the packet is added to the batch instead**/
         void Send(Packet* p) override {
-            write_buffer.Clear();
-            write_buffer.WriteStd(MAGIC_NUMBER);
-            write_buffer.Write<uint8_t>(0);
+            auto length = (uint32_t) p->BytesAvailable();
+            if(length > MaxLength()){
+                length = MaxLength();
+                truncated++;
+            }
+            if(batch_threshold > 0)
+                Batch(p->Interpret(), length);
+            else
+                SendFrame(p->Interpret(), length, false);
+            p->SeekDelta(length);
+        }
 
-            auto start = write_buffer.Position();
-            write_buffer.ReadFrom(*p);
-            auto length = write_buffer.Position() - start;
-            *write_buffer.Interpret(4) = length;                //Position of the size
+        /**Pack the messages of several Sends into one frame (one write) to save the framing and the write of each. The batch is sent
+         * once $threshold bytes are in it, $max_delay ms after its first message (0 waits for the threshold or Flush) or on Flush.
+         * The delay runs on a Timer, so the tasks have to be yielded. The frame ends with TAIL_BATCH_MAGIC_NUMBER, so any receiver
+         * unpacks it into its messages whether it coalesces or not. A $threshold of 0 turns it off**/
+        void Coalesce(int threshold, uint32_t max_delay = 0){
+            Flush();
+            batch_threshold = threshold;
+            batch.Reserve(threshold + MaxVarintBytes);
+            flush_timer.Repeat = false;
+            flush_timer.length = max_delay;
+            flush_timer.callback = GlobalLambda<void(Timer&)>([this](Timer&){ Flush(); });
+        }
 
-            write_buffer.WriteStd<uint8_t>(TAIL_MAGIC_NUMBER);
+        inline bool Coalescing() const { return batch_threshold > 0; }
 
-            write_buffer.SeekStart();
+        /**Send the batched messages now**/
+        void Flush(){
+            flush_timer.Stop();
+            if(batch.Size() == 0)
+                return;
+            SendFrame(batch.Interpret(0), batch.Size(), true);
+            batch.Clear();
+        }
 
-            Write(&write_buffer);
+        /**Compress frame payloads with $compressor (nullptr turns it off). A compressed frame ends with TAIL_COMPRESSED_MAGIC_NUMBER
+         * (TAIL_COMPRESSED_BATCH_MAGIC_NUMBER when coalesced) instead of the tail (which its checksum then covers), so a payload that does not get smaller is sent as it is and
+         * frames never grow. Both ends need it with the same dictionary. Takes two buffers of the read buffer's capacity**/
+        void Compress(Compressor* compressor){
+            Flush();
+            this->compressor = compressor;
+            if(compressor != nullptr && inflated.Capacity() < read_buffer.Capacity()){
+                deflated = IOArray((int) read_buffer.Capacity());
+                inflated = IOArray((int) read_buffer.Capacity());
+            }
         }
 
+        inline bool Compressing() const { return compressor != nullptr; }
+
+        /**Buffer the chunk and hand out every frame it completes. A chunk bigger than the free room in the read buffer is taken in pieces
+         * as frames are parsed**/
         void Receive(Packet* io) override {
-            read_buffer.SeekEnd();
-            read_buffer.ReadFrom(*io);
-            read_buffer.SeekStart();
+            do{
+                if(read_buffer.Size() == 0)
+                    read_buffer.Clear();            //Start at the front of the storage so frames are less likely to wrap
+                read_buffer.SeekEnd();
+                auto taken = read_buffer.ReadFrom(*io);
+                auto buffered = read_buffer.Size();
+                Parse();
+                if(taken == 0 && read_buffer.Size() == buffered)
+                    break;                      //No room was made, the rest of the chunk does not fit
+            }while(io->BytesAvailable() > 0);
+        }
 
-            uint32_t maybe_number = 0;
+        /**Take the read buffer, and the fresh one needed whenever a delivered message is kept, from $pool instead of the heap.
+         * Its buffers have to hold the read buffer's capacity. Falls back to the heap when the pool is exhausted**/
+        void UsePool(PacketPool* pool){
+            this->pool = pool;
+            read_buffer.Detach(FreshStorage());
+        }
 
-            while(read_buffer.TryReadStd(&maybe_number) && maybe_number != MAGIC_NUMBER)
-                read_buffer.SeekDelta(-3);   //Read next byte
+        /**Hand out every frame stored back to back in $log (a recording of the wire, like a MappedFileIO) from its position on.
+         * The frames are sliced straight out of its memory instead of going through the read buffer, so nothing is copied
+         * (only compressed frames are inflated). $log has to be contiguous and have Interpret(pos) and Slice(pos, length).
+         * Junk and broken frames are skipped as in Receive, a frame cut off by the end is left. The position is moved after
+         * the last whole frame. Return the frames found**/
+        template<typename L> size_t Replay(L& log){
+            uint8_t magic[sizeof(MAGIC_NUMBER)];
+            StoreStd(magic, MAGIC_NUMBER);
+            auto base = log.Interpret(0);
+            size_t pos = log.Position(), end = log.Size(), frames = 0;
+            while(end - pos >= sizeof(MAGIC_NUMBER)){
+                auto skip = (size_t) FindWord(base + pos, (int) min(end - pos, (size_t) INT_MAX), magic, sizeof(magic));
+                junk += skip;
+                pos += skip;
+                if(end - pos < sizeof(MAGIC_NUMBER))
+                    break;
+                if(LoadStd<uint32_t>(base + pos) != MAGIC_NUMBER){
+                    junk++;
+                    pos++;                      //Cut off by the end of the part that was scanned
+                    continue;
+                }
+                auto start = pos + sizeof(MAGIC_NUMBER);
+                uint32_t length;
+                auto field = DecodeLength(base + start, (int) min(end - start, (size_t) MaxVarintBytes), &length);
+                if(field < 0)
+                    break;                      //Cut off
+                if(field == 0 || length > (uint32_t) MaxPayload()){
+                    if(field > 0)
+                        corrupt++;
+                    pos = start;
+                    continue;
+                }
+                auto payload = start + field;
+                auto tail_at = payload + length + (int) check;
+                if(end - payload < (size_t) length + (int) check + sizeof(TAIL_MAGIC_NUMBER))
+                    break;                      //Cut off
+                auto tail = base[tail_at];
+                auto compressed = tail == TAIL_COMPRESSED_MAGIC_NUMBER || tail == TAIL_COMPRESSED_BATCH_MAGIC_NUMBER;
+                auto batched = tail == TAIL_BATCH_MAGIC_NUMBER || tail == TAIL_COMPRESSED_BATCH_MAGIC_NUMBER;
+                if((tail != TAIL_MAGIC_NUMBER && !batched && !compressed) || (compressed && compressor == nullptr)){
+                    pos = start;
+                    continue;
+                }
+                if(check != FrameCheck::None){
+                    Span parts[2] = {{base + payload, (int) length}, {&tail, 1}};
+                    auto expected = check == FrameCheck::CRC16 ? LoadStd<uint16_t>(base + payload + length) : LoadStd<uint32_t>(base + payload + length);
+                    if(expected != Checksum(base + start, field, parts, tail == TAIL_MAGIC_NUMBER ? 1 : 2)){
+                        corrupt++;
+                        pos = start;
+                        continue;
+                    }
+                }
+                Deliver(log, payload, (int) length, compressed, batched);
+                frames++;
+                pos = tail_at + sizeof(TAIL_MAGIC_NUMBER);
+            }
+            log.Seek(pos);
+            return frames;
+        }
 
-            uint8_t read_size = 0;
-            if(maybe_number == MAGIC_NUMBER && read_buffer.TryReadStd(&read_size)){
-                auto pos = read_buffer.Position();
-                uint8_t tail = 0;
+        /**Largest payload that fits in the read buffer with its frame and in the length field**/
+        inline int MaxPayload() const {
+            auto room = (int) read_buffer.Capacity() - (int) sizeof(MAGIC_NUMBER) - LengthFieldSize(read_buffer.Capacity()) - (int) check - (int) sizeof(TAIL_MAGIC_NUMBER);
+            return (int) min((uint32_t) max(room, 0), MaxLength());
+        }
+
+        virtual void ReceivedMessage(Packet* io) = 0;
+
+        /**Bytes thrown away while looking for the start of a frame (line noise, lost sync)**/
+        inline size_t JunkBytes() const { return junk; }
+
+        /**Frames dropped because their checksum did not match or they were too large for the read buffer**/
+        inline size_t CorruptFrames() const { return corrupt; }
 
-                read_buffer.SeekDelta(read_size);
-                if(!read_buffer.TryReadStd(&tail)) return;
-                read_buffer.Seek(pos);
+        /**Messages that were cut off because they were longer than the length field can hold**/
+        inline size_t TruncatedMessages() const { return truncated; }
 
-                if(tail == TAIL_MAGIC_NUMBER){
-                    auto rbs = read_buffer.Size();
-                    read_buffer.SetBytesAvailable(read_size);
-                    ReceivedMessage(&read_buffer);
-                    read_buffer.SetSize(rbs);
+        inline FrameCheck Check() const { return check; }
+        inline FrameLength LengthField() const { return length_field; }
 
-                    read_buffer.Seek(pos + read_size + sizeof(TAIL_MAGIC_NUMBER));
+    protected:
+        /**Every received message passes through here on its way to ReceivedMessage. Layers on top of the framing override it**/
+        virtual void Accept(Packet* p){ ReceivedMessage(p); }
+
+    private:
+        /**Frame $length bytes at $payload. $batched marks a payload of coalesced messages (see Batch) in the tail**/
+        void SendFrame(uint8_t* payload, uint32_t length, bool batched){
+            uint8_t header[sizeof(MAGIC_NUMBER) + 5];
+            uint8_t trailer[CRC32C::Size + sizeof(TAIL_MAGIC_NUMBER)];
+            uint8_t tail = batched ? TAIL_BATCH_MAGIC_NUMBER : TAIL_MAGIC_NUMBER;
+
+            if(compressor != nullptr && length > (uint32_t) sizeof(TAIL_MAGIC_NUMBER)){
+                auto n = compressor->Compress(payload, (int) length, deflated.Interpret(0), (int) min((uint32_t) deflated.Capacity(), length - 1));
+                if(n > 0){
+                    payload = deflated.Interpret(0);
+                    length = (uint32_t) n;
+                    tail = batched ? TAIL_COMPRESSED_BATCH_MAGIC_NUMBER : TAIL_COMPRESSED_MAGIC_NUMBER;
                 }
+            }
+
+            StoreStd(header, MAGIC_NUMBER);
+            auto field = EncodeLength(header + sizeof(MAGIC_NUMBER), length);
+
+            Span parts[3] = {{header, (int) sizeof(MAGIC_NUMBER) + field}, {payload, (int) length}, {&tail, 1}};
+            StoreCheck(trailer, Checksum(header + sizeof(MAGIC_NUMBER), field, parts + 1, tail == TAIL_MAGIC_NUMBER ? 1 : 2));
+            trailer[(int) check] = tail;
+            parts[2] = {trailer, (int) check + 1};
 
-                read_buffer.ClearToPosition();
-            }else
-                read_buffer.ClearToPosition();      //Junk Data
+            WriteV(parts, 3);
         }
 
-        virtual void ReceivedMessage(Packet* io) = 0;
+        /**Add a message to the batch as a varint length and its bytes. Flushes first when the frame would no longer fit the length field
+         * or a read buffer as large as this one (MaxPayload)**/
+        void Batch(uint8_t* message, uint32_t length){
+            auto limit = (uint32_t) MaxPayload();
+            if(batch.Size() + VarintSize(length) + length > limit)
+                Flush();
+            if(VarintSize(length) + length > limit){
+                length = limit > (uint32_t) VarintSize(limit) ? limit - VarintSize(limit) : 0;
+                truncated++;
+            }
+            uint8_t field[MaxVarintBytes];
+            batch.WriteBytes(field, EncodeVarint(field, length));
+            batch.WriteBytes(message, length);
+            if((int) batch.Size() >= batch_threshold)
+                Flush();
+            else if(flush_timer.length > 0 && !flush_timer.Active())
+                flush_timer.Start();
+        }
+
+        /**Hand out every complete frame in the read buffer. The parser keeps its state between calls, so bytes already looked at
+         * (skipped junk, a length that was read, the part of a body that arrived) are not looked at again. The ring always starts
+         * at the frame being parsed**/
+        void Parse(){
+            while(true){
+                switch(state){
+                    case ParseState::Sync:
+                        read_buffer.SeekStart();
+                        if(!Resync()){
+                            read_buffer.ClearToPosition();      //Junk Data, keeps a cut off magic number
+                            return;
+                        }
+                        read_buffer.SeekDelta(-(int) sizeof(MAGIC_NUMBER));
+                        read_buffer.ClearToPosition();
+                        state = ParseState::Length;
+                        //Fall through
+                    case ParseState::Length: {
+                        read_buffer.Seek(sizeof(MAGIC_NUMBER));
+                        auto result = ReadLength(&frame_length);
+                        if(result < 0)
+                            return;                             //Wait for the rest of the length
+                        if(result == 0 || frame_length > (uint32_t) MaxPayload()){
+                            if(result > 0)
+                                corrupt++;                      //Can never fit
+                            Skip(sizeof(MAGIC_NUMBER));
+                            continue;
+                        }
+                        payload_start = read_buffer.Position();
+                        if(!read_buffer.IsContiguous(0, payload_start + frame_length + (int) check + sizeof(TAIL_MAGIC_NUMBER)))
+                            read_buffer.Linearize();            //Cheap now, at most the start of the frame is buffered
+                        state = ParseState::Body;
+                    }
+                    //Fall through
+                    case ParseState::Body: {
+                        auto end = payload_start + frame_length + (int) check;
+                        if(read_buffer.Size() < end + sizeof(TAIL_MAGIC_NUMBER))
+                            return;                             //Wait for the rest of the body
+                        read_buffer.Seek(end);
+                        auto tail = read_buffer.ReadStd<uint8_t>();
+                        auto compressed = tail == TAIL_COMPRESSED_MAGIC_NUMBER || tail == TAIL_COMPRESSED_BATCH_MAGIC_NUMBER;
+                        auto batched = tail == TAIL_BATCH_MAGIC_NUMBER || tail == TAIL_COMPRESSED_BATCH_MAGIC_NUMBER;
+                        if((tail != TAIL_MAGIC_NUMBER && !batched && !compressed) || (compressed && compressor == nullptr)){
+                            Skip(sizeof(MAGIC_NUMBER));
+                            continue;
+                        }
+                        if(!IsIntact(payload_start, frame_length, tail)){
+                            corrupt++;
+                            Skip(sizeof(MAGIC_NUMBER));         //Resync after the magic number, the length itself may be what broke
+                            continue;
+                        }
+                        Deliver(payload_start, frame_length, compressed, batched);
+                        Skip(end + sizeof(TAIL_MAGIC_NUMBER));
+                    }
+                }
+            }
+        }
+
+        /**Drop the first $n bytes of the ring and look for the next frame**/
+        void Skip(size_t n){
+            read_buffer.Seek(n);
+            read_buffer.ClearToPosition();
+            state = ParseState::Sync;
+        }
+
+        /**Largest length the length field can hold**/
+        inline uint32_t MaxLength() const {
+            return length_field == FrameLength::Byte ? 0xFF : length_field == FrameLength::Short ? 0xFFFF : 0xFFFFFFFF;
+        }
+
+        inline int LengthFieldSize(uint32_t length) const { return length_field == FrameLength::Varint ? VarintSize(length) : (int) length_field; }
+
+        /**Write $length in the length field format. Return the bytes used**/
+        int EncodeLength(uint8_t* dst, uint32_t length){
+            switch(length_field){
+                case FrameLength::Byte: *dst = (uint8_t) length; return 1;
+                case FrameLength::Short: StoreStd(dst, (uint16_t) length); return 2;
+                case FrameLength::Int: StoreStd(dst, length); return 4;
+                default: return EncodeVarint(dst, length);
+            }
+        }
+
+        /**Read the length field. Return 1 if it was read, -1 if it has not fully arrived and 0 if it is broken. The position is left after it**/
+        int ReadLength(uint32_t* length){
+            uint8_t field[MaxVarintBytes];
+            auto pos = read_buffer.Position();
+            int n = read_buffer.ReadBytesUnlocked(field, length_field == FrameLength::Varint ? 5 : (int) length_field);
+            auto used = DecodeLength(field, n, length);
+            read_buffer.Seek(pos + max(used, 0));
+            return used > 0 ? 1 : used;
+        }
+
+        /**Decode the length field from the $n bytes at $src. Return the bytes it takes, -1 if they are not all there and 0 if it is broken**/
+        int DecodeLength(const uint8_t* src, int n, uint32_t* length){
+            if(length_field != FrameLength::Varint){
+                if(n < (int) length_field)
+                    return -1;
+                *length = length_field == FrameLength::Byte ? src[0] : length_field == FrameLength::Short ? LoadStd<uint16_t>(src) : LoadStd<uint32_t>(src);
+                return (int) length_field;
+            }
+            uint64_t v;
+            int used = DecodeVarint(src, n, &v);
+            if(used == 0)
+                return n < 5 ? -1 : 0;
+            if(v > 0xFFFFFFFF)
+                return 0;
+            *length = (uint32_t) v;
+            return used;
+        }
+
+        template<typename C> static uint32_t Checksum(const uint8_t* field, int field_size, const Span* parts, int count){
+            C c;
+            c.Update(field, field_size);
+            for(int i = 0; i < count; i++)
+                c.Update(parts[i].data, parts[i].length);
+            return c.Value();
+        }
+
+        /**The frame checksum of the length field and the payload $parts**/
+        uint32_t Checksum(const uint8_t* field, int field_size, const Span* parts, int count){
+            switch(check){
+                case FrameCheck::CRC16: return Checksum<CRC16>(field, field_size, parts, count);
+                case FrameCheck::CRC32C: return Checksum<CRC32C>(field, field_size, parts, count);
+                default: return 0;
+            }
+        }
+
+        void StoreCheck(uint8_t* dst, uint32_t value){
+            if(check == FrameCheck::CRC16)
+                StoreStd(dst, (uint16_t) value);
+            else if(check == FrameCheck::CRC32C)
+                StoreStd(dst, value);
+        }
+
+        /**Check the checksum after the $length byte payload at $pos (and the $tail of a compressed or batch frame). The payload is checked
+         * where it lies in the ring (even wrapped)**/
+        bool IsIntact(size_t pos, uint32_t length, uint8_t tail){
+            if(check == FrameCheck::None)
+                return true;
+            uint8_t field[MaxVarintBytes];
+            auto field_size = EncodeLength(field, length);
+            Span parts[3];
+            int count = read_buffer.Spans(parts, pos, length);
+            if(tail != TAIL_MAGIC_NUMBER)
+                parts[count++] = {&tail, 1};
+            uint32_t expected = 0;
+            read_buffer.Seek(pos + length);
+            if(check == FrameCheck::CRC16)
+                expected = read_buffer.ReadStd<uint16_t>();
+            else
+                expected = read_buffer.ReadStd<uint32_t>();
+            read_buffer.Seek(pos);
+            return expected == Checksum(field, field_size, parts, count);
+        }
+
+        /**Skip to the next magic number and read it. The ring is scanned a contiguous part at a time with FindWord. A magic number
+         * cut off by the end of the data is kept for the next Receive. Return if a whole one was read**/
+        bool Resync(){
+            uint8_t magic[sizeof(MAGIC_NUMBER)];
+            StoreStd(magic, MAGIC_NUMBER);
+            while(true){
+                auto src = read_buffer.PeekReadSpan();
+                if(src.length <= 0)
+                    return false;
+                auto skip = FindWord(src.data, src.length, magic, sizeof(magic));
+                read_buffer.CommitRead(skip);
+                junk += skip;
+                if(skip == src.length)
+                    continue;               //The rest is on the other side of the wrap
+
+                auto pos = read_buffer.Position();
+                uint32_t maybe_number;
+                if(!read_buffer.TryReadStd(&maybe_number)){
+                    read_buffer.Seek(pos);  //Cut off, wait for the rest
+                    return false;
+                }
+                if(maybe_number == MAGIC_NUMBER)
+                    return true;
+                read_buffer.Seek(pos + 1);  //Only the part before the wrap matched
+                junk++;
+            }
+        }
+
+        /**Hand the payload at $pos to ReceivedMessage as a slice of the read buffer (or of the buffer it was decompressed into). The message
+         * may be kept after the callback (copy the Packet), in which case the buffer moves to fresh storage instead of being overwritten.
+         * A $batched payload is unpacked into its messages**/
+        void Deliver(size_t pos, int length, bool compressed, bool batched){
+            if(!read_buffer.IsContiguous(pos, length))
+                read_buffer.Linearize();     //Only happens when a frame wraps the ring
+            Deliver(read_buffer, pos, length, compressed, batched);
+            if(read_buffer.Memory().use_count() > 1)
+                read_buffer.Detach(FreshStorage());
+        }
+
+        template<typename B> void Deliver(B& buffer, size_t pos, int length, bool compressed, bool batched){
+            if(!compressed)
+                Hand(buffer, pos, length, batched);
+            else{
+                auto n = compressor->Decompress(buffer.Interpret(pos), length, inflated.Interpret(0), (int) inflated.Capacity());
+                if(n < 0)
+                    corrupt++;
+                else
+                    Hand(inflated, 0, n, batched);
+                if(inflated.Memory().use_count() > 1){
+                    auto storage = FreshStorage();
+                    inflated = storage != nullptr ? IOArray(std::move(storage), (int) inflated.Capacity()) : IOArray((int) inflated.Capacity());
+                }
+            }
+        }
+
+        template<typename B> void Hand(B& buffer, size_t pos, int length, bool batched){
+            if(batched)
+                Unpack(buffer, pos, length);
+            else{
+                Packet view(buffer.Slice(pos, length));
+                Accept(&view);
+            }
+        }
+
+        /**Storage for the read buffer from the pool. nullptr (allocate it) when there is no pool, it is exhausted or its buffers are too small**/
+        ref<uint8_t> FreshStorage(){
+            return pool != nullptr && pool->BufferSize() >= read_buffer.Capacity() ? pool->Acquire() : nullptr;
+        }
+
+        /**Hand out each message of a coalesced frame at $pos as its own slice**/
+        template<typename B> void Unpack(B& buffer, size_t pos, int length){
+            auto data = buffer.Interpret(pos);
+            for(int offset = 0; offset < length;){
+                uint64_t n;
+                auto used = DecodeVarint(data + offset, length - offset, &n);
+                if(used == 0 || n > (uint64_t) (length - offset - used)){
+                    corrupt++;
+                    return;
+                }
+                Packet view(buffer.Slice(pos + offset + used, n));
+                Accept(&view);
+                offset += used + (int) n;
+            }
+        }
     };
 
     class ConnectionIO : public Connection{
@@ -115,6 +575,7 @@ namespace Simple {
 
     protected:
         void Write(IO* in) override { io->ReadFrom(*in); }
+        void WriteV(const Span* parts, int count) override { io->WriteBytesV(parts, count); }
     };
 }
 
@@ -0,0 +1,224 @@
+/**********************************************************************
+   NAME: SimpleFormat.hpp
+   AUTHOR: Johnathan Bizzano
+   DATE: 6/22/2023
+
+    The Simple Project
+		Medium Level (from Low) library that abstracts away from embedded device hardware
+
+    Simple Format
+		Number formatting kernels, the line buffer Printf assembles its output in
+		and the compile time parsed, type checked format strings used by print/println
+*********************************************************************/
+
+#ifndef SIMPLE_FORMAT_C_H
+#define SIMPLE_FORMAT_C_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <type_traits>
+
+#ifndef SIMPLE_PRINTF_BUFFER
+    #define SIMPLE_PRINTF_BUFFER 64     //Stack bytes a formatted line is assembled in before it is written
+#endif
+
+namespace Simple{
+    /**Most chars a formatted number can take (sign, 20 digits, point, 4 decimals)**/
+    constexpr int MaxFormatChars = 32;
+
+    static const char DigitPairs[201] =
+            "00010203040506070809"
+            "10111213141516171819"
+            "20212223242526272829"
+            "30313233343536373839"
+            "40414243444546474849"
+            "50515253545556575859"
+            "60616263646566676869"
+            "70717273747576777879"
+            "80818283848586878889"
+            "90919293949596979899";
+
+    /**Number of decimal digits of $v**/
+    inline int CountDigits(uint64_t v){
+        int n = 1;
+        while(true){
+            if(v < 10) return n;
+            if(v < 100) return n + 1;
+            if(v < 1000) return n + 2;
+            if(v < 10000) return n + 3;
+            v /= 10000;
+            n += 4;
+        }
+    }
+
+    /**Write the digits of $v to $dst two at a time, back to front so no reverse is needed. Return the chars written (no terminator)**/
+    inline int FormatUInt64(char* dst, uint64_t v){
+        int n = CountDigits(v);
+        char* p = dst + n;
+        while(v >= 100){
+            auto i = (int) (v % 100) * 2;
+            v /= 100;
+            *--p = DigitPairs[i + 1];
+            *--p = DigitPairs[i];
+        }
+        if(v >= 10){
+            auto i = (int) v * 2;
+            *--p = DigitPairs[i + 1];
+            *--p = DigitPairs[i];
+        }else
+            *--p = (char) ('0' + v);
+        return n;
+    }
+
+    /**Write $v to $dst. Return the chars written (no terminator)**/
+    inline int FormatInt64(char* dst, int64_t v){
+        if(v < 0){
+            *dst = '-';
+            return 1 + FormatUInt64(dst + 1, 0 - (uint64_t) v);
+        }
+        return FormatUInt64(dst, (uint64_t) v);
+    }
+
+    /**Write $d to $dst with up to 4 decimals. Return the chars written (no terminator)**/
+    inline int FormatFloat64(char* dst, double d){
+        int n = 0;
+        if(d < 0){
+            dst[n++] = '-';
+            d *= -1;
+        }
+        uint64_t units = floor(d);
+        n += FormatUInt64(dst + n, units);
+        auto decimals = (int) (10E3 * (d - units));
+        if(decimals > 0){
+            dst[n++] = '.';
+            dst[n++] = DigitPairs[(decimals / 100) * 2];
+            dst[n++] = DigitPairs[(decimals / 100) * 2 + 1];
+            dst[n++] = DigitPairs[(decimals % 100) * 2];
+            dst[n++] = DigitPairs[(decimals % 100) * 2 + 1];
+        }
+        return n;
+    }
+
+    /**Stack buffer a formatted line is assembled in so it reaches the $Sink with one WriteBytes. Flushes early when the line is too long**/
+    template<typename Sink>
+    struct FormatBuffer{
+        Sink& sink;
+        int length = 0;
+        char data[SIMPLE_PRINTF_BUFFER];
+
+        explicit FormatBuffer(Sink& sink) : sink(sink){}
+
+        void Flush(){
+            if(length > 0)
+                sink.WriteBytes((uint8_t*) data, length);
+            length = 0;
+        }
+
+        /**Get room for $n chars (n <= MaxFormatChars). Call Commit with the chars used**/
+        inline char* Reserve(int n){
+            if(length + n > SIMPLE_PRINTF_BUFFER)
+                Flush();
+            return data + length;
+        }
+
+        inline void Commit(int n){ length += n; }
+
+        inline void Append(char c){ *Reserve(1) = c; length++; }
+
+        inline void Append(const char* s, int n){
+            if(length + n > SIMPLE_PRINTF_BUFFER){
+                Flush();
+                if(n > SIMPLE_PRINTF_BUFFER){
+                    sink.WriteBytes((uint8_t*) s, n);
+                    return;
+                }
+            }
+            memcpy(data + length, s, n);
+            length += n;
+        }
+
+        inline void Append(const char* s){ Append(s, strlen(s)); }
+        inline void AppendUInt64(uint64_t v){ Commit(FormatUInt64(Reserve(MaxFormatChars), v)); }
+        inline void AppendInt64(int64_t v){ Commit(FormatInt64(Reserve(MaxFormatChars), v)); }
+        inline void AppendFloat64(double v){ Commit(FormatFloat64(Reserve(MaxFormatChars), v)); }
+    };
+
+    /**Base of the compile time format strings created by SIMPLE_FORMAT**/
+    struct FormatString{};
+
+    template<typename F> struct IsFormatString : std::is_base_of<FormatString, F>{};
+
+    namespace Internal{
+        constexpr bool IsConversion(char c){
+            return c == 'c' || c == 'b' || c == 'u' || c == 'i' || c == 'l' || c == 'f' || c == 'p' || c == 'U' || c == 's' || c == 'd';
+        }
+
+        /**Index of the next conversion at or after $i, or the index of the terminator**/
+        constexpr size_t NextConversion(const char* s, size_t i){
+            return s[i] == '\0' || (s[i] == '%' && (IsConversion(s[i + 1]) || s[i + 1] == '\0')) ? i : NextConversion(s, i + 1);
+        }
+
+        constexpr size_t CountConversions(const char* s, size_t i = 0){
+            return s[NextConversion(s, i)] == '\0' || s[NextConversion(s, i) + 1] == '\0' ? 0 : 1 + CountConversions(s, NextConversion(s, i) + 2);
+        }
+
+        template<char C, typename T> struct FormatAccepts : std::integral_constant<bool,
+                (C == 'c' || C == 'b' || C == 'i' || C == 'u' || C == 'l' || C == 'U') ? std::is_integral<T>::value || std::is_enum<T>::value :
+                (C == 'f' || C == 'd') ? std::is_arithmetic<T>::value :
+                C == 'p' ? std::is_pointer<T>::value || std::is_same<T, std::nullptr_t>::value :
+                C == 's' ? std::is_same<T, char*>::value || std::is_same<T, const char*>::value || std::is_same<T, std::string>::value :
+                false>{};
+
+        template<typename T> inline uint64_t AsUnsigned(T v, std::true_type){ return (typename std::make_unsigned<T>::type) v; }
+        template<typename T> inline uint64_t AsUnsigned(T v, std::false_type){ return (uint64_t) v; }
+
+        template<char C> struct FormatArg{};
+        template<> struct FormatArg<'c'>{ template<typename B, typename T> static inline void Append(B& out, const T& v){ out.Append((char) v); } };
+        template<> struct FormatArg<'b'>{ template<typename B, typename T> static inline void Append(B& out, const T& v){ if(v) out.Append("true", 4); else out.Append("false", 5); } };
+        template<> struct FormatArg<'i'>{ template<typename B, typename T> static inline void Append(B& out, const T& v){ out.AppendInt64((int64_t) v); } };
+        template<> struct FormatArg<'l'> : FormatArg<'i'>{};
+        template<> struct FormatArg<'u'>{
+            template<typename B, typename T> static inline void Append(B& out, const T& v){ out.AppendUInt64(AsUnsigned(v, std::integral_constant<bool, std::is_signed<T>::value>())); }
+        };
+        template<> struct FormatArg<'U'> : FormatArg<'u'>{};
+        template<> struct FormatArg<'f'>{ template<typename B, typename T> static inline void Append(B& out, const T& v){ out.AppendFloat64((double) v); } };
+        template<> struct FormatArg<'d'> : FormatArg<'f'>{};
+        template<> struct FormatArg<'p'>{ template<typename B, typename T> static inline void Append(B& out, const T& v){ out.AppendUInt64((uint64_t) (uintptr_t) v); } };
+        template<> struct FormatArg<'s'>{
+            template<typename B> static inline void Append(B& out, const char* v){ out.Append(v != nullptr ? v : "null"); }
+            template<typename B> static inline void Append(B& out, const std::string& v){ out.Append(v.data(), v.size()); }
+        };
+
+        /**The literal run of $F starting at $Pos and the conversion that ends it. Static constants, so the format string is parsed
+         * while compiling whatever the optimization level**/
+        template<typename F, size_t Pos> struct FormatRun{
+            static constexpr size_t Next = NextConversion(F::Value(), Pos);
+            static constexpr size_t Length = Next - Pos;
+            static constexpr char Conversion = F::Value()[Next] == '\0' ? '\0' : F::Value()[Next + 1];
+        };
+
+        /**Emit the literal run up to the next conversion, then the conversion, then recurse. Every offset and length is a constant**/
+        template<typename F, size_t Pos, typename B> inline void EmitFormat(B& out){
+            using Run = FormatRun<F, Pos>;
+            if(Run::Length > 0)
+                out.Append(F::Value() + Pos, (int) Run::Length);
+        }
+
+        template<typename F, size_t Pos, typename B, typename T, typename... Rest> inline void EmitFormat(B& out, const T& v, const Rest&... rest){
+            using Run = FormatRun<F, Pos>;
+            static_assert(FormatAccepts<Run::Conversion, typename std::decay<T>::type>::value, "Printf: argument type does not match its conversion");
+            if(Run::Length > 0)
+                out.Append(F::Value() + Pos, (int) Run::Length);
+            FormatArg<Run::Conversion>::Append(out, v);
+            EmitFormat<F, Run::Next + 2>(out, rest...);
+        }
+    }
+}
+
+/**Create a compile time format string from a string literal. Printf parses it while compiling, checks the argument types
+ * against the conversions and only copies the precomputed literal runs at runtime**/
+#define SIMPLE_FORMAT(fmt) ([]{ struct __simple_format__ : Simple::FormatString { static constexpr const char* Value(){ return fmt; } }; return __simple_format__(); }())
+
+#endif
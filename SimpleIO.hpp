@@ -15,6 +15,9 @@
 
 #include "SimpleLambda.hpp"
 #include "SimpleCore.hpp"
+#include "SimpleBytes.hpp"
+#include "SimpleSchema.hpp"
+#include "SimpleFormat.hpp"
 #include "stdarg.h"
 #include "string.h"
 #include <stdio.h>
@@ -25,14 +28,29 @@
 #include <vector>
 #include <string>
 
+#if defined(__unix__) || defined(__APPLE__)
+    #include <errno.h>
+    #include <sys/uio.h>
+    #include <unistd.h>
+    #define SIMPLE_POSIX
+#endif
+
 #include "SimpleMath.hpp"
 
 #ifndef print
-    #define print(fmt, ...) Out.Printf(fmt, ##__VA_ARGS__)
+    #define print(fmt, ...) Out.Printf(SIMPLE_FORMAT(fmt), ##__VA_ARGS__)
 #endif
 
 #ifndef printerr
-    #define printerr(fmt, ...) Error.Printf(fmt, ##__VA_ARGS__)
+    #define printerr(fmt, ...) Error.Printf(SIMPLE_FORMAT(fmt), ##__VA_ARGS__)
+#endif
+
+#ifndef SIMPLE_SWAP_BLOCK
+    #define SIMPLE_SWAP_BLOCK 256       //Stack bytes used to byte swap bulk arrays before writing
+#endif
+
+#ifndef SIMPLE_TRANSFER_BLOCK
+    #define SIMPLE_TRANSFER_BLOCK 256   //Stack bytes used to copy between two IO that do not expose their memory
 #endif
 
 #define println(fmt, ...) print(fmt "\r\n", ##__VA_ARGS__)
@@ -53,6 +71,15 @@ namespace Simple {
     struct IOArray;
     struct SeekableIO;
 
+    /**A contiguous region of memory**/
+    struct Span {
+        uint8_t* data;
+        int length;
+    };
+
+    /**Types that can be moved in bulk with WriteStd/ReadStd (contiguous, only needs a byte swap)**/
+    template<typename T> struct IsStdBulk : integral_constant<bool, is_arithmetic<T>::value && !is_same<T, bool>::value>{};
+
     /**Base Implementation of a stream. Is a wrapper over ports
      **/
     struct IO {
@@ -65,6 +92,27 @@ namespace Simple {
         /** Write the bytes from this IO to another IO **/
         virtual int WriteBytes(uint8_t *ptr, int nbytes) = 0;
 
+        /** Write several buffers to the stream in order (scatter/gather). Return the bytes written **/
+        virtual int WriteBytesV(const Span* parts, int count){
+            int written = 0;
+            for(int i = 0; i < count; i++)
+                written += WriteBytes(parts[i].data, parts[i].length);
+            return written;
+        }
+
+        /** Contiguous readable bytes at the read position, without consuming them. Empty when the IO does not expose its memory **/
+        virtual Span PeekReadSpan(){ return {nullptr, 0}; }
+
+        /** Consume $n bytes of the span returned by PeekReadSpan **/
+        virtual void CommitRead(int /*n*/){}
+
+        /** Contiguous room for up to $n bytes at the write position (may be shorter). Empty when the IO does not expose its memory.
+         * Always follow it with CommitWrite of the bytes that were filled in **/
+        virtual Span PrepareWriteSpan(int /*n*/){ return {nullptr, 0}; }
+
+        /** Make $n bytes of the span returned by PrepareWriteSpan part of the stream **/
+        virtual void CommitWrite(int /*n*/){}
+
         /** Write a byte to the stream **/
         int WriteByte(uint8_t b){ return WriteBytes(&b, 1); }
 
@@ -75,19 +123,31 @@ namespace Simple {
         int ReadFrom(IO& io){ return ReadFrom(io, io.BytesAvailable()); }
         int ReadFrom(IO& io, int bytes){ return io.WriteTo(*this, bytes); }
 
-        /** Read $bytes bytes from another IO to this IO  **/
+        /** Write $bytes bytes from this IO to another IO. Copies once from or into whichever side exposes its memory and only
+         * goes through a stack buffer when neither does. Return the bytes moved **/
         int WriteTo(IO& io, int bytes){
-            int buf_size = min(BUFSIZ, min(bytes, BytesAvailable()));
-            int bytes_remaining = bytes;
-            uint8_t buffer[buf_size];
-
-            while (bytes_remaining > 0 && BytesAvailable() > 0){
-                int read = ReadBytesUnlocked(buffer, min(buf_size, bytes_remaining));
-                bytes_remaining -= read;
-                io.WriteBytes(buffer, read);
+            bytes = min(bytes, BytesAvailable());
+            int moved = 0;
+            while(moved < bytes){
+                int n;
+                auto src = PeekReadSpan();
+                auto dst = src.length > 0 ? Span{nullptr, 0} : io.PrepareWriteSpan(bytes - moved);
+                if(src.length > 0){
+                    n = io.WriteBytes(src.data, min(src.length, bytes - moved));
+                    CommitRead(n);
+                }else if(dst.length > 0){
+                    n = ReadBytesUnlocked(dst.data, dst.length);
+                    io.CommitWrite(n);
+                }else{
+                    uint8_t buffer[SIMPLE_TRANSFER_BLOCK];
+                    n = ReadBytesUnlocked(buffer, min(SIMPLE_TRANSFER_BLOCK, bytes - moved));
+                    io.WriteBytes(buffer, n);
+                }
+                if(n <= 0)
+                    break;
+                moved += n;
             }
-
-            return bytes;
+            return moved;
         }
 
         /** Write the bytes from this IO to another IO **/
@@ -126,53 +186,16 @@ namespace Simple {
         /** Convert a Digit (value) to a Digit (char) **/
         char Dig2Char(int i) { return (i >= 0 && i <= 9) ? (char) ('0' + i) : '?'; }
 
-        /** Print a UInt64 number to the stream. The buffer should be big enough to handle all digits **/
-        void PrintUInt64(char *buffer, uint64_t l) {
-            if (l == 0) {
-                WriteByte('0');
-                return;
-            }
-            int i = 0, k = 0, hl;
-            while (l > 0) {
-                buffer[i++] = Dig2Char((int) (l % 10));
-                l /= 10;
-            }
-            //Reverse Order
-            for (hl = i / 2; k < hl; k++) {
-                int idx2 = i - k - 1;
-                char tmp = buffer[k];
-                buffer[k] = buffer[idx2];
-                buffer[idx2] = tmp;
-            }
-            buffer[i] = '\0';
-            WriteUnsafeString(buffer);
-        }
+        /** Print a UInt64 number to the stream. The buffer should be big enough to handle all digits (20) **/
+        void PrintUInt64(char *buffer, uint64_t l) { WriteBytes((uint8_t*) buffer, FormatUInt64(buffer, l)); }
 
-        /** Print a Int64 number to the stream. The buffer should be big enough to handle all digits **/
-        void PrintInt64(char *buffer, int64_t l) {
-            if (l < 0) {
-                WriteByte('-');
-                l *= -1;
-            }
-            PrintUInt64(buffer, (uint64_t) l);
-        }
+        /** Print a Int64 number to the stream. The buffer should be big enough to handle all digits (21) **/
+        void PrintInt64(char *buffer, int64_t l) { WriteBytes((uint8_t*) buffer, FormatInt64(buffer, l)); }
 
-        /** Print a Float64 number to the stream. The buffer should be big enough to handle all digits **/
-        void PrintFloat64(char *buffer, double d) {
-            if (d < 0) {
-                WriteByte('-');
-                d *= -1;
-            }
-            uint64_t units = floor(d);
-            PrintUInt64(buffer, units);
-            uint64_t decimals = (uint64_t) (10E3 * (d - units));
-            if (decimals > 0) {
-                WriteByte('.');
-                PrintUInt64(buffer, decimals);
-            }
-        }
+        /** Print a Float64 number to the stream. The buffer should be big enough to handle all digits (MaxFormatChars) **/
+        void PrintFloat64(char *buffer, double d) { WriteBytes((uint8_t*) buffer, FormatFloat64(buffer, d)); }
 
-        /**Print to the io using the simple printf impl. The buffer should be able to handle the digits of the biggest number used
+        /**Print to the io using the simple printf impl. The line is assembled in a stack buffer and written with one WriteBytes
          * %c -> char
          * %b -> bool
          * %u -> uint
@@ -183,62 +206,64 @@ namespace Simple {
          * %U -> ulong
          * %s -> string (null terminated)
          * %d -> double**/
-        void vPrintbf(char *buffer, char *fmt, va_list sprintf_args) {
+        void vPrintbf(FormatBuffer<IO>& out, const char *fmt, va_list sprintf_args) {
             while (true) {
-                switch (*fmt) {
-                    case '%':
-                        fmt++;
-                        switch (*(fmt++)) {
-                            case 'c':
-                                WriteByte((uint8_t) va_arg(sprintf_args, int));
-                                break;
-                            case 'b':
-                                WriteUnsafeString(va_arg(sprintf_args, int) ? "true" : "false");
-                                break;
-                            case 'i':
-                                PrintInt64(buffer, va_arg(sprintf_args, int));
-                                break;
-                            case 'u':
-                                PrintUInt64(buffer, va_arg(sprintf_args, unsigned int));
-                                break;
-                            case 'l':
-                                PrintInt64(buffer, va_arg(sprintf_args, long));
-                                break;
-                            case 'U':
-                                PrintUInt64(buffer, va_arg(sprintf_args, unsigned long));
-                                break;
-                            case 'f':
-                                PrintFloat64(buffer, va_arg(sprintf_args, double));
-                                break;
-                            case 'd':
-                                PrintFloat64(buffer, va_arg(sprintf_args, double));
-                                break;
-                            case 'p':
-                                PrintUInt64(buffer, (uint64_t) va_arg(sprintf_args, void*));
-                                break;
-                            case 's':
-                                WriteUnsafeString(va_arg(sprintf_args, char*));
-                                break;
-                            case '\0':
-                                return;
-                            default:
-                                WriteByte('%');
-                                fmt--;
-                                break;
-                        }
+                auto run = fmt;
+                while(*fmt != '%' && *fmt != '\0')
+                    fmt++;
+                if(fmt != run)
+                    out.Append(run, fmt - run);
+                if(*fmt == '\0')
+                    return;
+                fmt++;
+                switch (*(fmt++)) {
+                    case 'c':
+                        out.Append((char) va_arg(sprintf_args, int));
+                        break;
+                    case 'b':
+                        out.Append(va_arg(sprintf_args, int) ? "true" : "false");
+                        break;
+                    case 'i':
+                        out.AppendInt64(va_arg(sprintf_args, int));
+                        break;
+                    case 'u':
+                        out.AppendUInt64(va_arg(sprintf_args, unsigned int));
+                        break;
+                    case 'l':
+                        out.AppendInt64(va_arg(sprintf_args, long));
+                        break;
+                    case 'U':
+                        out.AppendUInt64(va_arg(sprintf_args, unsigned long));
+                        break;
+                    case 'f':
+                    case 'd':
+                        out.AppendFloat64(va_arg(sprintf_args, double));
+                        break;
+                    case 'p':
+                        out.AppendUInt64((uint64_t) (uintptr_t) va_arg(sprintf_args, void*));
+                        break;
+                    case 's': {
+                        auto str = va_arg(sprintf_args, char*);
+                        out.Append(str != nullptr ? str : "null");
                         break;
+                    }
                     case '\0':
                         return;
                     default:
-                        WriteByte(*(fmt++));
-                        continue;
+                        out.Append('%');
+                        fmt--;
+                        break;
                 }
             }
         }
 
+        /**Print to the io using the simple printf impl. The buffer is no longer used, digits are formatted straight into the line**/
+        void vPrintbf(char* /*buffer*/, char *fmt, va_list sprintf_args) { vPrintf(fmt, sprintf_args); }
+
         void vPrintf(char *fmt, va_list list){
-            char buffer[15];    //Probaly good enough
-            vPrintbf(buffer, fmt, list);
+            FormatBuffer<IO> out(*this);
+            vPrintbf(out, fmt, list);
+            out.Flush();
         }
 
         /**Print a null terminated string to the io using the simple printf impl.
@@ -253,11 +278,13 @@ namespace Simple {
          * %s -> string (null terminated)
          * %d -> double**/
         void PrintfEnd(char *fmt, ...) {
+            FormatBuffer<IO> out(*this);
             va_list sprintf_args;
             va_start(sprintf_args, fmt);
-            vPrintf(fmt, sprintf_args);
+            vPrintbf(out, fmt, sprintf_args);
             va_end(sprintf_args);
-            WriteByte('\0');
+            out.Append('\0');
+            out.Flush();
         }
 
 
@@ -273,11 +300,13 @@ namespace Simple {
          * %s -> string (null terminated)
          * %d -> double**/
         void PrintfEnd(const char *fmt, ...) {
+            FormatBuffer<IO> out(*this);
             va_list sprintf_args;
             va_start(sprintf_args, fmt);
-            vPrintf((char*) fmt, sprintf_args);
+            vPrintbf(out, fmt, sprintf_args);
             va_end(sprintf_args);
-            WriteByte('\0');
+            out.Append('\0');
+            out.Flush();
         }
 
         /**Print a string to the io using the simple printf impl.
@@ -316,6 +345,37 @@ namespace Simple {
             va_end(sprintf_args);
         }
 
+        /**Print with a compile time format string (SIMPLE_FORMAT, used by print/println). The format is parsed while compiling and
+         * a conversion that does not fit its argument or a wrong argument count fails to compile. Integral conversions format
+         * the argument at its own width, so %i/%l/%u/%U accept any integral type
+         * %c -> char
+         * %b -> bool
+         * %u -> uint
+         * %i -> int
+         * %l -> long
+         * %f -> float
+         * %p -> ptr
+         * %U -> ulong
+         * %s -> string (null terminated or std::string)
+         * %d -> double**/
+        template<typename F, typename... Args>
+        typename std::enable_if<IsFormatString<F>::value, void>::type Printf(F, const Args&... args){
+            static_assert(Internal::CountConversions(F::Value()) == sizeof...(Args), "Printf: the number of arguments does not match the format");
+            FormatBuffer<IO> out(*this);
+            Internal::EmitFormat<F, 0>(out, args...);
+            out.Flush();
+        }
+
+        /**Print with a compile time format string (SIMPLE_FORMAT) followed by a null terminator**/
+        template<typename F, typename... Args>
+        typename std::enable_if<IsFormatString<F>::value, void>::type PrintfEnd(F, const Args&... args){
+            static_assert(Internal::CountConversions(F::Value()) == sizeof...(Args), "Printf: the number of arguments does not match the format");
+            FormatBuffer<IO> out(*this);
+            Internal::EmitFormat<F, 0>(out, args...);
+            out.Append('\0');
+            out.Flush();
+        }
+
         /**Write a raw value to the stream
          * WARNING: DO NOT USE THIS FOR TYPES THAT ARE NOT PORTABLE AND SEND THEM ACROSS THE NETWORK
          * USE WriteStd at the minimum**/
@@ -352,7 +412,7 @@ namespace Simple {
 
         /**Write a standardized value to the stream. Use this for integral types etc to send information to different devices**/
         template<typename T>
-        void WriteStd(T v) {
+        typename std::enable_if<!HasSchema<T>::value, void>::type WriteStd(T v) {
             if (std::is_integral<T>() || std::is_floating_point<T>()) {
                 WriteStd<T,
 #if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
@@ -364,6 +424,21 @@ namespace Simple {
             }else WriteStd<T, false>(&v);
         }
 
+        /**Write a value that has a SIMPLE_SCHEMA. The fields are encoded straight-line into one buffer and written with one WriteBytes**/
+        template<typename T>
+        typename std::enable_if<HasSchema<T>::value, void>::type WriteStd(const T& v) {
+            auto dst = PrepareWriteSpan(SchemaOf<T>::WireSize);
+            if(dst.length >= (int) SchemaOf<T>::WireSize){
+                SchemaOf<T>::Encode(dst.data, v);
+                CommitWrite(SchemaOf<T>::WireSize);
+                return;
+            }
+            CommitWrite(0);
+            uint8_t buffer[SchemaOf<T>::WireSize];
+            SchemaOf<T>::Encode(buffer, v);
+            WriteBytes(buffer, SchemaOf<T>::WireSize);
+        }
+
         template<std::size_t I = 0, typename... Tp> inline typename std::enable_if<I == sizeof...(Tp), void>::type WriteStd(std::tuple<Tp...> t){ }
         template<std::size_t I = 0, typename... Tp> inline typename std::enable_if<I < sizeof...(Tp), void>::type
         WriteStd(std::tuple<Tp...> t){
@@ -371,17 +446,52 @@ namespace Simple {
             WriteStd<I+1, Tp...>(t);
         }
 
-        /**Write a standardized value to the stream. Use this for integral types etc to send information to different devices**/
-        template<typename T, int S> void WriteStd(std::array<T, S>& a){
-            for(int i = 0; i < S; i++)
-                WriteStd(a[i]);
+        /**Write $count standardized values to the stream. Arithmetic types are byte swapped straight into the stream memory when it is
+         * exposed, otherwise in blocks written with one WriteBytes per block**/
+        template<typename T> typename std::enable_if<IsStdBulk<T>::value, void>::type WriteStd(T* v, int count){
+            if(!HostRequiresByteSwap || sizeof(T) == 1){
+                WriteBytes((uint8_t*) v, count * sizeof(T));
+                return;
+            }
+            auto dst = PrepareWriteSpan(count * sizeof(T));
+            if(dst.length >= (int) (count * sizeof(T))){
+                SwapBytes(dst.data, (uint8_t*) v, count, sizeof(T));
+                CommitWrite(count * sizeof(T));
+                return;
+            }
+            CommitWrite(0);
+            const int block_count = SIMPLE_SWAP_BLOCK / sizeof(T);
+            uint8_t block[block_count * sizeof(T)];
+            auto src = (uint8_t*) v;
+            while(count > 0){
+                int n = min(count, block_count);
+                SwapBytes(block, src, n, sizeof(T));
+                WriteBytes(block, n * sizeof(T));
+                src += n * sizeof(T);
+                count -= n;
+            }
         }
 
+        /**Write $count standardized values to the stream. Use this for integral types etc to send information to different devices**/
+        template<typename T> typename std::enable_if<!IsStdBulk<T>::value, void>::type WriteStd(T* v, int count){
+            for(int i = 0; i < count; i++)
+                WriteStd(v[i]);
+        }
+
+        /**Write a standardized value to the stream. Use this for integral types etc to send information to different devices**/
+        template<typename T, size_t S> void WriteStd(std::array<T, S>& a){ WriteStd(a.data(), (int) S); }
+
         /**Write a standardized value to the stream. Use this for integral types etc to send information to different devices**/
         template<typename T> void WriteStd(std::vector<T>& a){
             WriteStd((uint32_t) a.size());
-            for(int i = 0; i < a.size(); i++)
-                WriteStd(a[i]);
+            WriteStd(a.data(), (int) a.size());
+        }
+
+        /**Write a standardized value to the stream. Use this for integral types etc to send information to different devices**/
+        void WriteStd(std::vector<bool>& a){
+            WriteStd((uint32_t) a.size());
+            for(size_t i = 0; i < a.size(); i++)
+                WriteStd((bool) a[i]);
         }
 
         /**Write a standardized value to the stream. Use this for integral types etc to send information to different devices**/
@@ -429,7 +539,7 @@ namespace Simple {
         int ReadString(int* length, IOVector& b);
 
         /**Read a standardized value from the stream. Use this for integral types etc to send information to different devices**/
-        template<typename T> void ReadStd(T *v) {
+        template<typename T> typename std::enable_if<!HasSchema<T>::value, void>::type ReadStd(T *v) {
             Read(v, 1);
             if(std::is_integral<T>() || std::is_floating_point<T>())
                 ReadStd<T,
@@ -441,10 +551,30 @@ namespace Simple {
                 >(v);
         }
 
-        /**Read a standardized value from the stream. Use this for integral types etc to send information to different devices**/
-        template<typename T> void ReadStd(T* v, int count){
+        /**Read a value that has a SIMPLE_SCHEMA. The wire bytes are read with one Read and decoded straight-line**/
+        template<typename T> typename std::enable_if<HasSchema<T>::value, void>::type ReadStd(T *v) {
+            auto src = PeekReadSpan();
+            if(src.length >= (int) SchemaOf<T>::WireSize){
+                SchemaOf<T>::Decode(src.data, *v);
+                CommitRead(SchemaOf<T>::WireSize);
+                return;
+            }
+            uint8_t buffer[SchemaOf<T>::WireSize];
+            Read(buffer, SchemaOf<T>::WireSize);
+            SchemaOf<T>::Decode(buffer, *v);
+        }
+
+        /**Read $count standardized values from the stream. Arithmetic types are read with one Read and byte swapped in place**/
+        template<typename T> typename std::enable_if<IsStdBulk<T>::value, void>::type ReadStd(T* v, int count){
+            Read(v, count);
+            if(HostRequiresByteSwap)
+                SwapBytes((uint8_t*) v, (uint8_t*) v, count, sizeof(T));
+        }
+
+        /**Read $count standardized values from the stream. Use this for integral types etc to send information to different devices**/
+        template<typename T> typename std::enable_if<!IsStdBulk<T>::value, void>::type ReadStd(T* v, int count){
             for(int i = 0; i < count; i++)
-                ReadStd<T>(v + i);
+                ReadStd(v + i);
         }
 
         /**Read a standardized value from the stream. Use this for integral types etc to send information to different devices**/
@@ -472,17 +602,21 @@ namespace Simple {
         }
 
         /**Read a standardized array from the stream. Use this for integral types etc to send information to different devices**/
-        template<typename T, int S> void ReadStd(std::array<T, S>* a){
-            for(int i = 0; i < S; i++)
-                ReadStd<T>(&(*a)[i]);
-        }
+        template<typename T, size_t S> void ReadStd(std::array<T, S>* a){ ReadStd(a->data(), (int) S); }
 
         /**Read a standardized vector from the stream. Use this for integral types etc to send information to different devices**/
         template<typename T> void ReadStd(std::vector<T>* a){
             auto s = ReadStd<uint32_t>();
             a->resize(s);
-            for(int i = 0; i < s; i++)
-                ReadStd<T>(&(*a)[i]);
+            ReadStd(a->data(), (int) s);
+        }
+
+        /**Read a standardized vector from the stream. Use this for integral types etc to send information to different devices**/
+        void ReadStd(std::vector<bool>* a){
+            auto s = ReadStd<uint32_t>();
+            a->resize(s);
+            for(uint32_t i = 0; i < s; i++)
+                (*a)[i] = ReadStd<bool>();
         }
 
         /**Read a standardized value from the stream. Use this for integral types etc to send information to different devices**/
@@ -490,9 +624,62 @@ namespace Simple {
             apply(lam, ReadStd<tuple<TArgs...>>());
         }
 
+        /**Read a vector or string (anything written with WriteStd(vector)/WriteString) into memory from $arena instead of the heap.
+         * Nested spans are read the same way. When the arena is full the span is left empty, the bytes are still consumed and it returns false.
+         * A length that the rest of the stream cannot hold (a broken or cut off message) also returns false, without reading past the end**/
+        template<typename T> bool ReadStd(ArenaSpan<T>* s, Arena& arena){
+            uint32_t n;
+            if(!TryReadStd(&n)){
+                *s = ArenaSpan<T>();
+                return false;
+            }
+            return ReadArenaSpan(s, n, ArenaStdSize((T*) nullptr, 0), arena, [this](T* v, int count, Arena& a){ return ReadArenaElements(v, count, a, 0); });
+        }
+
+        /**Read a vector written with WriteCompact into memory from $arena. Nested spans are read the same way**/
+        template<typename T> bool ReadCompact(ArenaSpan<T>* s, Arena& arena){
+            uint32_t n;
+            if(!TryReadCompact(&n)){
+                *s = ArenaSpan<T>();
+                return false;
+            }
+            return ReadArenaSpan(s, n, ArenaCompactSize((T*) nullptr, 0), arena, [this](T* v, int count, Arena& a){ return ReadCompactArenaElements(v, count, a, 0); });
+        }
+
+        /**Write a span in the same format as WriteStd(vector)**/
+        template<typename T> void WriteStd(const ArenaSpan<T>& s){
+            WriteStd(s.size);
+            WriteArenaElements(s.data, (int) s.size, 0);
+        }
+
+        /**Write a span in the same format as WriteCompact(vector)**/
+        template<typename T> void WriteCompact(const ArenaSpan<T>& s){
+            WriteCompact(s.size);
+            WriteCompactArenaElements(s.data, (int) s.size, 0);
+        }
+
+        /**Drop $n bytes from the stream. Return the bytes dropped**/
+        int Skip(int n){
+            int skipped = 0;
+            while(skipped < n){
+                auto src = PeekReadSpan();
+                int read;
+                if(src.length > 0)
+                    CommitRead(read = min(src.length, n - skipped));
+                else{
+                    uint8_t buffer[SIMPLE_TRANSFER_BLOCK];
+                    read = ReadBytesUnlocked(buffer, min(SIMPLE_TRANSFER_BLOCK, n - skipped));
+                }
+                if(read <= 0)
+                    break;
+                skipped += read;
+            }
+            return skipped;
+        }
+
         /**Try to read a value from IO. Return if it could or not **/
         template<typename T> inline bool TryRead(T* t, int count = 1){
-            if(BytesAvailable() >= sizeof(T) * count){
+            if(BytesAvailable() >= (int) (sizeof(T) * count)){
                 Read<T>(t, count);
                 return true;
             }else return false;
@@ -500,13 +687,225 @@ namespace Simple {
 
         /**Try to read a std value from IO. Return if it could or not **/
         template<typename T> inline bool TryReadStd(T* t, int count = 1){
-            if(BytesAvailable() >= sizeof(T) * count){
+            if(BytesAvailable() >= (int) (StdSize<T>(0) * count)){
                 ReadStd(t, count);
                 return true;
             }else return false;
         }
 
+        /**Write an integral value in the compact encoding: a varint for unsigned values, a zigzag varint for signed ones.
+         * Small values take 1 byte instead of sizeof(T). Both sides must agree to use it**/
+        template<typename T> typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, void>::type WriteCompact(T v){
+            auto u = CompactBits(v);
+            auto dst = PrepareWriteSpan(MaxVarintBytes);
+            if(dst.length >= MaxVarintBytes){
+                CommitWrite(EncodeVarint(dst.data, u));
+                return;
+            }
+            CommitWrite(0);
+            uint8_t buffer[MaxVarintBytes];
+            WriteBytes(buffer, EncodeVarint(buffer, u));
+        }
+
+        /**Write $count integral values in the compact encoding, encoded straight into the stream memory when it is exposed**/
+        template<typename T> typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, void>::type WriteCompact(T* v, int count){
+            uint8_t buffer[SIMPLE_SWAP_BLOCK];
+            int i = 0;
+            while(i < count){
+                auto dst = PrepareWriteSpan((count - i) * MaxVarintBytes);
+                bool direct = dst.length >= MaxVarintBytes;
+                if(!direct){
+                    CommitWrite(0);
+                    dst = {buffer, sizeof(buffer)};
+                }
+                int n = 0;
+                for(; i < count && n + MaxVarintBytes <= dst.length; i++)
+                    n += EncodeVarint(dst.data + n, CompactBits(v[i]));
+                if(direct)
+                    CommitWrite(n);
+                else WriteBytes(buffer, n);
+            }
+        }
+
+        /**Write an array with its elements in the compact encoding**/
+        template<typename T, size_t S> void WriteCompact(std::array<T, S>& a){ WriteCompact(a.data(), (int) S); }
+
+        /**Write a vector with a varint length. Integral elements use the compact encoding, the rest use WriteStd**/
+        template<typename T> void WriteCompact(std::vector<T>& a){
+            WriteCompact((uint32_t) a.size());
+            WriteCompactElements(a.data(), (int) a.size(), 0);
+        }
+
+        /**Read an integral value written with WriteCompact. Decodes in place when the stream exposes its memory**/
+        template<typename T> typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, void>::type ReadCompact(T* v){
+            uint64_t u = 0;
+            auto src = PeekReadSpan();
+            int n = src.length > 0 ? DecodeVarint(src.data, src.length, &u) : 0;
+            if(n > 0)
+                CommitRead(n);
+            else{
+                uint8_t b;
+                int shift = 0;
+                do{
+                    b = Read<uint8_t>();
+                    u |= (uint64_t) (b & 0x7F) << shift;
+                    shift += 7;
+                }while((b & 0x80) && shift < 7 * MaxVarintBytes);
+            }
+            *v = FromCompactBits<T>(u);
+        }
+
+        /**Try to read an integral value written with WriteCompact. Return false when the stream ends inside it**/
+        template<typename T> typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, bool>::type TryReadCompact(T* v){
+            uint64_t u = 0;
+            auto src = PeekReadSpan();
+            int n = src.length > 0 ? DecodeVarint(src.data, src.length, &u) : 0;
+            if(n > 0)
+                CommitRead(n);
+            else{
+                uint8_t b;
+                int shift = 0;
+                do{
+                    if(!TryRead(&b))
+                        return false;
+                    u |= (uint64_t) (b & 0x7F) << shift;
+                    shift += 7;
+                }while((b & 0x80) && shift < 7 * MaxVarintBytes);
+            }
+            *v = FromCompactBits<T>(u);
+            return true;
+        }
+
+        /**Read $count integral values written with WriteCompact**/
+        template<typename T> typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, void>::type ReadCompact(T* v, int count){
+            int i = 0;
+            while(i < count){
+                auto src = PeekReadSpan();
+                uint64_t u;
+                int used = 0;
+                for(int n; i < count && (n = DecodeVarint(src.data + used, src.length - used, &u)) > 0; i++, used += n)
+                    v[i] = FromCompactBits<T>(u);
+                if(used > 0)
+                    CommitRead(used);
+                else ReadCompact(v + i++);      //Not exposed or split, take one value the slow way
+            }
+        }
+
+        template<typename T> T ReadCompact(){
+            T t;
+            ReadCompact(&t);
+            return t;
+        }
+
+        /**Read an array with its elements in the compact encoding**/
+        template<typename T, size_t S> void ReadCompact(std::array<T, S>* a){ ReadCompact(a->data(), (int) S); }
+
+        /**Read a vector written with WriteCompact**/
+        template<typename T> void ReadCompact(std::vector<T>* a){
+            auto s = ReadCompact<uint32_t>();
+            a->resize(s);
+            ReadCompactElements(a->data(), (int) s, 0);
+        }
+
     private:
+        /**Read the $n elements of a span, each taking at least $element_size bytes on the wire**/
+        template<typename T, typename F> bool ReadArenaSpan(ArenaSpan<T>* s, uint32_t n, size_t element_size, Arena& arena, F elements){
+            const bool terminate = std::is_same<T, char>::value;
+            s->data = nullptr;
+            s->size = 0;
+            //$n comes off the wire, more elements than the rest of the stream can hold is a broken message
+            if((uint64_t) n * element_size > (uint64_t) max(BytesAvailable(), 0))
+                return false;
+            auto room = arena.Remaining() / sizeof(T);
+            if(room >= (size_t) terminate && n <= room - terminate)
+                s->data = arena.Allocate<T>((size_t) n + terminate);
+            if(s->data == nullptr){
+                T discard[1];
+                for(uint32_t i = 0; i < n; i++){
+                    auto before = BytesAvailable();
+                    if(!elements(discard, 1, arena) && BytesAvailable() == before)
+                        break;                          //Consume the elements so the stream stays in sync, up to a short read
+                }
+                return false;
+            }
+            s->size = n;
+            if(terminate)
+                ((char*) s->data)[n] = '\0';
+            return elements(s->data, (int) n, arena);
+        }
+
+        template<typename T> bool ReadArenaElements(ArenaSpan<T>* v, int count, Arena& arena, int){
+            bool ok = true;
+            for(int i = 0; i < count; i++)
+                ok &= ReadStd(v + i, arena);
+            return ok;
+        }
+        template<typename T> bool ReadArenaElements(T* v, int count, Arena&, long){ return TryReadStd(v, count); }
+
+        template<typename T> bool ReadCompactArenaElements(ArenaSpan<T>* v, int count, Arena& arena, int){
+            bool ok = true;
+            for(int i = 0; i < count; i++)
+                ok &= ReadCompact(v + i, arena);
+            return ok;
+        }
+        template<typename T> bool ReadCompactArenaElements(T* v, int count, Arena&, long){ return TryReadCompactElements(v, count, 0); }
+
+        /**Fewest bytes an element of an arena span takes on the wire (a nested span takes at least its length)**/
+        template<typename T> static constexpr size_t ArenaStdSize(ArenaSpan<T>*, int){ return sizeof(uint32_t); }
+        template<typename T> static constexpr size_t ArenaStdSize(T*, long){ return StdSize<T>(0); }
+        template<typename T> static constexpr size_t ArenaCompactSize(ArenaSpan<T>*, int){ return 1; }
+        template<typename T> static constexpr size_t ArenaCompactSize(T*, long){
+            return std::is_integral<T>::value && !std::is_same<T, bool>::value ? 1 : StdSize<T>(0);
+        }
+
+        template<typename T> void WriteArenaElements(ArenaSpan<T>* v, int count, int){
+            for(int i = 0; i < count; i++)
+                WriteStd(v[i]);
+        }
+        template<typename T> void WriteArenaElements(T* v, int count, long){ WriteStd(v, count); }
+
+        template<typename T> void WriteCompactArenaElements(ArenaSpan<T>* v, int count, int){
+            for(int i = 0; i < count; i++)
+                WriteCompact(v[i]);
+        }
+        template<typename T> void WriteCompactArenaElements(T* v, int count, long){ WriteCompactElements(v, count, 0); }
+
+        template<typename T> static inline typename std::enable_if<std::is_enum<T>::value, uint64_t>::type CompactBits(T v){
+            return CompactBits((typename std::underlying_type<T>::type) v);
+        }
+        template<typename T> static inline typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, uint64_t>::type CompactBits(T v){
+            return ZigZag(v);
+        }
+        template<typename T> static inline typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value, uint64_t>::type CompactBits(T v){
+            return v;
+        }
+
+        template<typename T> static inline typename std::enable_if<std::is_enum<T>::value, T>::type FromCompactBits(uint64_t u){
+            return (T) FromCompactBits<typename std::underlying_type<T>::type>(u);
+        }
+        template<typename T> static inline typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, T>::type FromCompactBits(uint64_t u){
+            return (T) UnZigZag(u);
+        }
+        template<typename T> static inline typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value, T>::type FromCompactBits(uint64_t u){
+            return (T) u;
+        }
+
+        template<typename T> typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value, void>::type WriteCompactElements(T* v, int count, int){ WriteCompact(v, count); }
+        template<typename T> void WriteCompactElements(T* v, int count, long){ WriteStd(v, count); }
+        template<typename T> typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value, void>::type ReadCompactElements(T* v, int count, int){ ReadCompact(v, count); }
+        template<typename T> void ReadCompactElements(T* v, int count, long){ ReadStd(v, count); }
+        template<typename T> typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value, bool>::type TryReadCompactElements(T* v, int count, int){
+            for(int i = 0; i < count; i++)
+                if(!TryReadCompact(v + i))
+                    return false;
+            return true;
+        }
+        template<typename T> bool TryReadCompactElements(T* v, int count, long){ return TryReadStd(v, count); }
+
+        /**Bytes a fixed size value takes on the wire**/
+        template<typename T> static constexpr size_t StdSize(typename std::enable_if<HasSchema<T>::value, int>::type){ return SchemaOf<T>::WireSize; }
+        template<typename T> static constexpr size_t StdSize(long){ return sizeof(T); }
+
         template<std::size_t I = 0, typename... Tp> inline typename std::enable_if<I == sizeof...(Tp), void>::type ReadStdArgs(std::tuple<Tp...>& t, std::tuple<Tp&...>& at){ }
         template<std::size_t I = 0, typename... Tp> inline typename std::enable_if<I < sizeof...(Tp), void>::type
         ReadStdArgs(std::tuple<Tp...>& t, std::tuple<Tp&...>& at){
@@ -529,7 +928,7 @@ namespace Simple {
     };
 
     class IOVector : public SeekableIO {
-        size_t position = 0, max_size = 0;
+        size_t position = 0, max_size = 0, prepared_size = 0;
         std::vector<uint8_t> memory;
     public:
         IOVector() : max_size(numeric_limits<long>::max()){}
@@ -583,6 +982,22 @@ namespace Simple {
             }
         }
 
+        Span PeekReadSpan() final { return {memory.data() + position, max(BytesAvailable(), 0)}; }
+        void CommitRead(int n) final { position += n; }
+
+        Span PrepareWriteSpan(int n) final {
+            prepared_size = memory.size();
+            n = (int) min((size_t) n, max_size - min(max_size, position));
+            if(position + n > memory.size())
+                memory.resize(position + n);
+            return {memory.data() + position, n};
+        }
+
+        void CommitWrite(int n) final {
+            position += n;
+            memory.resize(max(prepared_size, position));     //Drop the room that was not filled in
+        }
+
         inline size_t Capacity() { return memory.capacity(); }
         inline void SetSize(size_t s){ memory.resize(s); }
         inline void Reserve(size_t s) { memory.reserve(s); }
@@ -645,7 +1060,7 @@ namespace Simple {
         size_t Size() final { return size; }
         inline size_t Capacity() const { return capacity; }
 
-        explicit IOArray(int capacity = BUFSIZ) : memory(new uint8_t[capacity]), capacity(capacity), size(0), position(0){}
+        explicit IOArray(int capacity = BUFSIZ) : memory(new uint8_t[capacity], default_delete<uint8_t[]>()), capacity(capacity), size(0), position(0){}
         IOArray(ref<uint8_t> heap_ref, int capacity, int size = 0) : memory(std::move(heap_ref)), capacity(capacity), size(size), position(0){}
 
         int WriteByte(uint8_t c) {
@@ -664,9 +1079,9 @@ namespace Simple {
                 memmove(Begin(), ptr, nbytes);
                 WriteSize(nbytes);
                 position += nbytes;
-                return true;
+                return nbytes;
             }
-            return false;
+            return 0;
         }
 
         int ReadByte() { return memory.get()[position++]; }
@@ -689,6 +1104,14 @@ namespace Simple {
             return 0;
         }
 
+        Span PeekReadSpan() final { return {Begin(), max(BytesAvailable(), 0)}; }
+        void CommitRead(int n) final { position += n; }
+        Span PrepareWriteSpan(int n) final { return {Begin(), (int) min((size_t) n, capacity - min(capacity, position))}; }
+        void CommitWrite(int n) final {
+            WriteSize(n);
+            position += n;
+        }
+
         void Reserve(size_t s) {
             if(s > capacity){
                 auto p = new uint8_t[s];
@@ -714,6 +1137,35 @@ namespace Simple {
         /**Read the raw memory of the io at the specified position **/
         template<typename T = uint8_t> T* Interpret(){ return (T*) &memory.get()[position]; }
 
+        /**View the fixed size wire value at the position and skip over it without decoding it. Invalid when the array is too short**/
+        template<typename T> StdView<T> ViewStd(){
+            if(BytesAvailable() < (int) StdWire<T>::Size)
+                return StdView<T>();
+            StdView<T> v(Begin());
+            position += StdWire<T>::Size;
+            return v;
+        }
+
+        /**View a vector (or string) written with WriteStd at the position and skip over it in O(1), whatever its length.
+         * Only the length is decoded, the elements are decoded when they are accessed. Invalid when the array is too short**/
+        template<typename T> StdArrayView<T> ViewStdArray(){
+            if(BytesAvailable() < (int) sizeof(uint32_t))
+                return StdArrayView<T>();
+            auto size = LoadStd<uint32_t>(Begin());
+            if((size_t) BytesAvailable() - sizeof(uint32_t) < (size_t) size * StdWire<T>::Size)
+                return StdArrayView<T>();
+            StdArrayView<T> v(Begin() + sizeof(uint32_t), size);
+            position += sizeof(uint32_t) + v.WireSize();
+            return v;
+        }
+
+        /**A view of $length bytes at $offset sharing this array's memory (no copy). The view has its own position and size,
+         * so it can be kept, queued or parsed later without touching the state of this array**/
+        IOArray Slice(size_t offset, size_t length){ return IOArray(ref<uint8_t>(memory, memory.get() + offset), length, length); }
+
+        /**Shared reference to the raw storage of the array**/
+        inline ref<uint8_t>& Memory(){ return memory; }
+
         void Clear(){
             position = 0;
             size = 0;
@@ -760,28 +1212,238 @@ namespace Simple {
         }
     };
 
+    /**Fixed capacity circular buffer. The capacity is rounded up to a power of two so wrapping is a mask.
+     * Positions are relative to the head, so consumed bytes are dropped by moving the head (ClearToPosition) instead of copying
+     **/
+    struct RingIO : public SeekableIO{
+    private:
+        ref<uint8_t> memory;
+        size_t head, position, size, mask;
+
+        static size_t RoundCapacity(size_t c){
+            size_t p = 1;
+            while(p < c)
+                p <<= 1;
+            return p;
+        }
+
+        inline size_t Index(size_t pos) const { return (head + pos) & mask; }
+
+        void WriteSize(int length){
+            auto pl = position + length;
+            if(pl > size)
+                size = pl;
+        }
+
+    public:
+        explicit RingIO(int capacity = BUFSIZ) : head(0), position(0), size(0), mask(RoundCapacity(capacity) - 1){
+            memory.reset(new uint8_t[mask + 1], default_delete<uint8_t[]>());
+        }
+
+        void Seek(size_t pos) final { position = pos; }
+        size_t Position() final { return position; }
+        size_t Size() final { return size; }
+        inline size_t Capacity() const { return mask + 1; }
+        inline size_t Free() const { return Capacity() - size; }
+
+        int WriteByte(uint8_t c){
+            if(position < Capacity()){
+                memory.get()[Index(position)] = c;
+                WriteSize(1);
+                position++;
+                return 1;
+            }
+            return 0;
+        }
+
+        int WriteBytes(uint8_t *ptr, int nbytes) override{
+            nbytes = min(nbytes, (int) (Capacity() - min(position, Capacity())));
+            if(nbytes <= 0)
+                return 0;
+            auto idx = Index(position);
+            auto first = min((size_t) nbytes, Capacity() - idx);
+            memcpy(memory.get() + idx, ptr, first);
+            memcpy(memory.get(), ptr + first, nbytes - first);
+            WriteSize(nbytes);
+            position += nbytes;
+            return nbytes;
+        }
+
+        int ReadByte() { return memory.get()[Index(position++)]; }
+
+        int ReadBytesUnlocked(uint8_t *ptr, int buffer_size) override{
+            auto read_bytes = min(buffer_size, BytesAvailable());
+            if(read_bytes <= 0)
+                return 0;
+            auto idx = Index(position);
+            auto first = min((size_t) read_bytes, Capacity() - idx);
+            memcpy(ptr, memory.get() + idx, first);
+            memcpy(ptr + first, memory.get(), read_bytes - first);
+            position += read_bytes;
+            return read_bytes;
+        }
+
+        Span PeekReadSpan() final {
+            auto available = max(BytesAvailable(), 0);
+            return {memory.get() + Index(position), (int) min((size_t) available, Capacity() - Index(position))};
+        }
+        void CommitRead(int n) final { position += n; }
+
+        Span PrepareWriteSpan(int n) final {
+            auto room = Capacity() - min(position, Capacity());
+            return {memory.get() + Index(position), (int) min(min((size_t) n, room), Capacity() - Index(position))};
+        }
+        void CommitWrite(int n) final {
+            WriteSize(n);
+            position += n;
+        }
+
+        /**Get the contiguous spans that hold $length bytes starting at $pos. Returns the number of spans used (0-2)**/
+        int Spans(Span* spans, size_t pos, size_t length){
+            if(length == 0)
+                return 0;
+            auto idx = Index(pos);
+            auto first = min(length, Capacity() - idx);
+            spans[0] = {memory.get() + idx, (int) first};
+            if(first == length)
+                return 1;
+            spans[1] = {memory.get(), (int) (length - first)};
+            return 2;
+        }
+
+        /**Get the contiguous spans of the readable bytes. Returns the number of spans used (0-2)**/
+        int Spans(Span* spans){ return Spans(spans, position, BytesAvailable()); }
+
+        /**Check if $length bytes at $pos are stored without wrapping around the end of the buffer**/
+        inline bool IsContiguous(size_t pos, size_t length) const { return Index(pos) + length <= Capacity(); }
+
+        /**Read the raw memory of the io at the specified position. Only valid when the value does not wrap (see IsContiguous)**/
+        template<typename T = uint8_t> T* Interpret(size_t pos){ return (T*) &memory.get()[Index(pos)]; }
+        /**Read the raw memory of the io at the current position. Only valid when the value does not wrap (see IsContiguous)**/
+        template<typename T = uint8_t> T* Interpret(){ return Interpret<T>(position); }
+
+        /**Shared reference to the raw storage of the ring**/
+        inline ref<uint8_t>& Memory(){ return memory; }
+
+        /**A view of $length bytes at $pos sharing the ring's memory (no copy). The bytes must be contiguous (see IsContiguous, Linearize)**/
+        IOArray Slice(size_t pos, size_t length){ return IOArray(ref<uint8_t>(memory, Interpret(pos)), length, length); }
+
+        /**Move the contents to fresh storage. Used when slices still reference the current storage so they keep their bytes.
+         * $storage (at least Capacity bytes, e.g. from a BufferPool) is used when given, otherwise it is allocated**/
+        void Detach(ref<uint8_t> storage = nullptr){
+            if(storage == nullptr)
+                storage.reset(new uint8_t[Capacity()], default_delete<uint8_t[]>());
+            Span spans[2];
+            int offset = 0;
+            for(int i = 0, n = Spans(spans, 0, size); i < n; i++){
+                memcpy(storage.get() + offset, spans[i].data, spans[i].length);
+                offset += spans[i].length;
+            }
+            memory = std::move(storage);
+            head = 0;
+        }
+
+        /**Move the contents to the beginning of the memory. Only needed when a caller requires a single span.
+         * Costs a move of the contents when they do not wrap, otherwise a rotate of the whole storage**/
+        void Linearize(){
+            if(head == 0)
+                return;
+            auto m = memory.get();
+            if(IsContiguous(0, size))
+                memmove(m, m + head, size);
+            else
+                std::rotate(m, m + head, m + Capacity());
+            head = 0;
+        }
+
+        void Clear(){
+            head = 0;
+            position = 0;
+            size = 0;
+        }
+
+        /**Drop everything before the current position. O(1)**/
+        void ClearToPosition(){
+            head = Index(position);
+            size -= position;
+            position = 0;
+        }
+
+        void Print(IO& io){
+            io.WriteByte('[');
+            for(auto i = position; i < size; i++){
+                if(i != position)
+                    io.Printf(", %i", memory.get()[Index(i)]);
+                else io.Printf("%i", memory.get()[Index(i)]);
+            }
+            io.Printf(": Size=%i, Position=%i, Capacity=%i]\n\r", Size(), Position(), Capacity());
+        }
+
+        inline int ReadFrom(IO& io, int bytes){ return IO::ReadFrom(io, bytes); }
+        inline int ReadFrom(IO& io){ return IO::ReadFrom(io); }
+        int WriteTo(IO& io){ return WriteTo(io, BytesAvailable()); }
+        int WriteTo(IO& io, int count){
+            Span spans[2];
+            int written = 0;
+            for(int i = 0, n = Spans(spans, position, min(count, BytesAvailable())); i < n; i++){
+                io.WriteBytes(spans[i].data, spans[i].length);
+                written += spans[i].length;
+            }
+            position += written;
+            return written;
+        }
+    };
+
     template<typename... Chars>
     int IO::ReadStringUntilChars(Simple::SeekableIO& buffer, bool greedy, Chars ...stop_chars) {
-        uint8_t c;
+        const uint8_t stops[] = {(uint8_t) stop_chars...};
+        const int count = sizeof...(Chars);
         auto pos = buffer.Position();
         bool foundStopChar = false;
         while (true) {
-            c = ReadByte();
-            for (auto stop_char: {stop_chars...}) {
-                if (c == stop_char){
-                    if(!greedy){
-                        buffer.WriteByte('\0');
-                        return pos;
-                    }
+            auto src = PeekReadSpan();
+            if(src.length <= 0){
+                //No exposed memory (or drained). A stream can not be peeked, so the char after the stop chars is lost when greedy
+                int c = ReadByte();
+                if(c < 0)
+                    break;
+                if(Internal::IsAnyOf(c, stops, count)){
                     foundStopChar = true;
-                }else if(foundStopChar){
-                    buffer.WriteByte('\0');
+                    if(!greedy)
+                        break;
+                }else if(foundStopChar)
+                    break;
+                else if(buffer.WriteByte(c) < 1) //Didnt Write
                     return pos;
-                }
+                continue;
             }
-            if(!foundStopChar && buffer.WriteByte(c) < 1) //Didnt Write
+
+            if(foundStopChar){
+                //Skip the rest of the run of stop chars
+                int n = 0;
+                while(n < src.length && Internal::IsAnyOf(src.data[n], stops, count))
+                    n++;
+                CommitRead(n);
+                if(n < src.length)
+                    break;
+                continue;
+            }
+
+            //Copy the whole run up to the first stop char at once
+            int n = FindAny(src.data, src.length, stops, count);
+            int written = buffer.WriteBytes(src.data, n);
+            CommitRead(written);
+            if(written < n) //Didnt Write
                 return pos;
+            if(n == src.length)
+                continue;
+            CommitRead(1);
+            foundStopChar = true;
+            if(!greedy)
+                break;
         }
+        buffer.WriteByte('\0');
+        return pos;
     }
 
     template<typename T>
@@ -799,13 +1461,183 @@ namespace Simple {
         return pos;
     }
 
+    /**Read only IO over a list of spans. Lets several buffers be handed to an IO consumer without joining them**/
+    struct GatherIO : public IO{
+    private:
+        const Span* parts;
+        int count, index = 0, offset = 0, remaining = 0;
+    public:
+        GatherIO(const Span* parts, int count) : parts(parts), count(count){
+            for(int i = 0; i < count; i++)
+                remaining += parts[i].length;
+        }
+
+        int BytesAvailable() final { return remaining; }
+        int WriteBytes(uint8_t* /*ptr*/, int /*nbytes*/) final { return 0; }
+
+        Span PeekReadSpan() final { return index < count ? Span{parts[index].data + offset, parts[index].length - offset} : Span{nullptr, 0}; }
+
+        void CommitRead(int n) final {
+            offset += n;
+            remaining -= n;
+            if(offset == parts[index].length){
+                index++;
+                offset = 0;
+            }
+        }
+
+        int ReadBytesUnlocked(uint8_t *ptr, int buffer_size) final {
+            int read = 0;
+            while(read < buffer_size && index < count){
+                auto& part = parts[index];
+                int n = min(buffer_size - read, part.length - offset);
+                memcpy(ptr + read, part.data + offset, n);
+                read += n;
+                offset += n;
+                if(offset == part.length){
+                    index++;
+                    offset = 0;
+                }
+            }
+            remaining -= read;
+            return read;
+        }
+    };
+
+    /**Splits a stream that arrives in chunks into lines ('\n' ends a line, a '\r' in front of it is dropped).
+     * A line that lies inside one chunk is handed out as a span into the chunk (no copy). Only the part of a line that
+     * crosses chunks is carried over, and at most $max_line bytes of it are kept (the rest of the line is cut off).
+     *  LineSplitter lines;
+     *  lines.Feed(packet, [](Span line){ ... });   //Spans are only valid during the call
+     * **/
+    struct LineSplitter{
+    private:
+        IOVector carry;
+        int truncated = 0;
+        bool cut = false;
+
+        void Carry(uint8_t* data, int length){
+            if(carry.WriteBytes(data, length) < length)
+                cut = true;
+        }
+
+        template<typename F> void Emit(uint8_t* data, int length, F& f){
+            if(length > 0 && data[length - 1] == '\r')
+                length--;
+            f(Span{data, length});
+        }
+    public:
+        explicit LineSplitter(int max_line = 256) : carry(0, max_line){ carry.Reserve(max_line); }
+
+        /**Call $f(Span line) for every line completed by the $length bytes at $data. Return the lines found**/
+        template<typename F> int Feed(uint8_t* data, int length, F f){
+            int lines = 0;
+            while(length > 0){
+                uint8_t stop = '\n';
+                int n = FindAny(data, length, &stop, 1);
+                if(n == length){
+                    Carry(data, n);
+                    break;
+                }
+                if(carry.Size() == 0 && !cut)
+                    Emit(data, n, f);                   //Whole line in the chunk
+                else{
+                    Carry(data, n);
+                    Emit(carry.Size() > 0 ? carry.Interpret(0) : data, carry.Size(), f);
+                    Reset();
+                }
+                lines++;
+                data += n + 1;
+                length -= n + 1;
+            }
+            return lines;
+        }
+
+        /**Split everything available in $io. Sources that expose their memory are not copied**/
+        template<typename F> int Feed(IO& io, F f){
+            int lines = 0;
+            while(true){
+                auto src = io.PeekReadSpan();
+                if(src.length > 0){
+                    lines += Feed(src.data, src.length, f);
+                    io.CommitRead(src.length);
+                    continue;
+                }
+                uint8_t buffer[SIMPLE_TRANSFER_BLOCK];
+                int n = io.ReadBytesUnlocked(buffer, min(SIMPLE_TRANSFER_BLOCK, io.BytesAvailable()));
+                if(n <= 0)
+                    return lines;
+                lines += Feed(buffer, n, f);
+            }
+        }
+
+        /**Hand out the unterminated line at the end of the stream, if there is one. Return if there was**/
+        template<typename F> bool Finish(F f){
+            if(carry.Size() == 0)
+                return false;
+            Emit(carry.Interpret(0), carry.Size(), f);
+            Reset();
+            return true;
+        }
+
+        /**Drop the unfinished line**/
+        void Reset(){
+            if(cut)
+                truncated++;
+            cut = false;
+            carry.Clear();
+        }
+
+        /**Bytes of an unfinished line being carried over**/
+        inline int Pending(){ return carry.Size(); }
+        /**Lines that were longer than $max_line and cut off**/
+        inline int Truncated() const { return truncated; }
+    };
+
     /**Implementation of the IO to a FILE***/
     struct FileIO : public IO{
         FILE* out, *in;
 
         FileIO(FILE* out, FILE* in) : out(out), in(in){}
         int WriteByte(uint8_t c){ return putc(c, out) == EOF ? 0 : 1; }
-        int WriteBytes(uint8_t *ptr, int nbytes) final { return fwrite(ptr, nbytes, 1, out); }
+        int WriteBytes(uint8_t *ptr, int nbytes) final { return fwrite(ptr, 1, nbytes, out); }
+
+        /**Small writes are gathered in the FILE buffer. Large writes flush it and go out with one writev**/
+        int WriteBytesV(const Span* parts, int count) final {
+#ifdef SIMPLE_POSIX
+            int total = 0;
+            for(int i = 0; i < count; i++)
+                total += parts[i].length;
+            if(total >= BUFSIZ && count <= 16){
+                struct iovec iov[16];
+                for(int i = 0; i < count; i++)
+                    iov[i] = {parts[i].data, (size_t) parts[i].length};
+                fflush(out);
+                //Finish a short writev with the rest of the parts. Return what was written when it fails
+                int written = 0, first = 0;
+                while(first < count){
+                    auto n = writev(fileno(out), iov + first, count - first);
+                    if(n < 0){
+                        if(errno == EINTR)
+                            continue;
+                        break;
+                    }
+                    written += (int) n;
+                    for(; first < count && (size_t) n >= iov[first].iov_len; first++)
+                        n -= iov[first].iov_len;
+                    if(first < count){
+                        iov[first].iov_base = (uint8_t*) iov[first].iov_base + n;
+                        iov[first].iov_len -= n;
+                    }
+                }
+                return written;
+            }
+#endif
+            int written = 0;
+            for(int i = 0; i < count; i++)
+                written += fwrite(parts[i].data, 1, parts[i].length, out);
+            return written;
+        }
         int ReadByte() { return getc(in); }
         int ReadBytesUnlocked(uint8_t *ptr, int buffer_size) final { return fread(ptr, 1, buffer_size, in); }
         int BytesAvailable() final { return feof(out) ? 1 : 0; }
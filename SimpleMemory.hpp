@@ -8,13 +8,19 @@
 
     Simple Memory
 		Provide abstract Ref support (local refs, global refs, static refs etc)
+		and a bump allocator (Arena) that decoded messages can live in
+		and a pool of fixed size buffers (BufferPool) that are recycled instead of going back to the heap
 *********************************************************************/
 
 #ifndef SIMPLE_MEMORY_H
 #define SIMPLE_MEMORY_H
 
 #include <stdint.h>
+#include <stddef.h>
+#include <string.h>
 #include <memory>
+#include <new>
+#include <type_traits>
 
 namespace Simple{
     template<typename T>
@@ -44,5 +50,173 @@ namespace Simple{
     template<typename T> inline ref<T> Ref(T* t, bool owns){ return ref<T>(t, RefDeleter<T>(owns)); }
 
     struct Empty{};
+
+    /**Bump allocator over one block of memory. Allocating moves a cursor and everything is freed at once with Reset,
+     * so a whole decoded message costs no malloc/free. Only for types that do not need a destructor
+     * Use it like this
+     *  uint8_t memory[512];
+     *  Arena arena(memory, sizeof(memory));
+     *  ArenaSpan<uint16_t> samples;
+     *  packet.ReadStd(&samples, arena);    //The elements live in memory
+     *  arena.Reset();                      //Free the message
+     * **/
+    struct Arena{
+    private:
+        ref<uint8_t> owned;
+        uint8_t* memory;
+        size_t capacity, used = 0, high_water = 0;
+    public:
+        /**Allocate out of caller supplied memory**/
+        Arena(uint8_t* memory, size_t capacity) : memory(memory), capacity(capacity){}
+
+        /**Allocate out of a block owned by the arena**/
+        explicit Arena(size_t capacity) : owned(new uint8_t[capacity], std::default_delete<uint8_t[]>()), memory(owned.get()), capacity(capacity){}
+
+        /**Get $bytes aligned to $align. Return nullptr when the arena is full**/
+        void* Allocate(size_t bytes, size_t align = alignof(max_align_t)){
+            auto start = ((uintptr_t) memory + used + align - 1) & ~(uintptr_t) (align - 1);
+            auto end = start - (uintptr_t) memory + bytes;
+            if(end > capacity)
+                return nullptr;
+            used = end;
+            if(used > high_water)
+                high_water = used;
+            return (void*) start;
+        }
+
+        /**Get room for $count values of $T. They are not constructed**/
+        template<typename T> T* Allocate(size_t count){
+            static_assert(std::is_trivially_destructible<T>::value, "Arena: the type would never be destroyed");
+            return (T*) Allocate(count * sizeof(T), alignof(T));
+        }
+
+        /**Free everything allocated**/
+        inline void Reset(){ used = 0; }
+
+        /**The current cursor. Rewind to it to free everything allocated after it**/
+        inline size_t Mark() const { return used; }
+        inline void Rewind(size_t mark){ used = mark; }
+
+        inline size_t Used() const { return used; }
+        inline size_t Capacity() const { return capacity; }
+        inline size_t Remaining() const { return capacity - used; }
+        /**Most bytes that were in use at once. Use it to size the arena**/
+        inline size_t HighWater() const { return high_water; }
+    };
+
+    /**A counted array that lives in an Arena (or any memory it does not own). Char spans are also null terminated**/
+    template<typename T> struct ArenaSpan{
+        T* data = nullptr;
+        uint32_t size = 0;
+
+        inline T* begin() const { return data; }
+        inline T* end() const { return data + size; }
+        inline T& operator[](size_t i) const { return data[i]; }
+        inline bool Empty() const { return size == 0; }
+        inline const char* CStr() const { return data != nullptr ? (const char*) data : ""; }
+    };
+
+    /**A fixed number of fixed size buffers allocated once. Acquire pops a buffer off a freelist in O(1) and hands it out as a ref.
+     * When the last ref to it is gone the buffer goes back on the freelist instead of to the heap. The ref's control block lives in
+     * the buffer's slot too, so acquiring does not touch the heap at all. Not thread safe, and the pool has to outlive its buffers
+     * Use it like this
+     *  BufferPool pool(8, 256);
+     *  ref<uint8_t> buffer = pool.Acquire();   //nullptr when all 8 are in use
+     * **/
+    struct BufferPool{
+    private:
+        /**Room reserved in front of every buffer for the ref's control block**/
+        static constexpr size_t ControlBytes = 64;
+
+        ref<uint8_t> owned;
+        uint8_t* memory;
+        size_t buffer_size, slot_size;
+        int count, free_head, in_use = 0, high_water = 0;
+        size_t acquired = 0, exhausted = 0;
+
+        inline uint8_t* Slot(int i) const { return memory + i * slot_size; }
+        inline int Next(int i) const { int n; memcpy(&n, Slot(i), sizeof(n)); return n; }
+        inline void SetNext(int i, int n){ memcpy(Slot(i), &n, sizeof(n)); }
+
+        void Release(int i){
+            SetNext(i, free_head);
+            free_head = i;
+            in_use--;
+        }
+
+        /**Puts the control block of a buffer's ref in the buffer's slot and puts the buffer back on the freelist once the control
+         * block is gone (after the last ref and any weak ref)**/
+        template<typename T> struct SlotAllocator{
+            using value_type = T;
+            BufferPool* pool;
+            int index;
+
+            SlotAllocator(BufferPool* pool, int index) : pool(pool), index(index){}
+            template<typename U> SlotAllocator(const SlotAllocator<U>& o) : pool(o.pool), index(o.index){}
+
+            T* allocate(size_t n){
+                if(n * sizeof(T) <= ControlBytes)
+                    return (T*) pool->Slot(index);
+                return (T*) ::operator new(n * sizeof(T));    //A library with a larger control block. Still correct
+            }
+
+            void deallocate(T* p, size_t){
+                if((uint8_t*) p != pool->Slot(index))
+                    ::operator delete(p);
+                pool->Release(index);
+            }
+
+            template<typename U> bool operator==(const SlotAllocator<U>& o) const { return pool == o.pool && index == o.index; }
+            template<typename U> bool operator!=(const SlotAllocator<U>& o) const { return !(*this == o); }
+        };
+
+        void Link(){
+            free_head = count > 0 ? 0 : -1;
+            for(int i = 0; i < count; i++)
+                SetNext(i, i + 1 < count ? i + 1 : -1);
+        }
+
+    public:
+        /**Bytes of memory $count buffers of $buffer_size take (to supply them yourself)**/
+        static size_t MemorySize(int count, size_t buffer_size){
+            return count * (ControlBytes + (buffer_size + alignof(max_align_t) - 1) / alignof(max_align_t) * alignof(max_align_t));
+        }
+
+        /**Carve the buffers out of caller supplied memory of MemorySize bytes, aligned to max_align_t**/
+        BufferPool(uint8_t* memory, int count, size_t buffer_size) : memory(memory), buffer_size(buffer_size),
+                slot_size(MemorySize(1, buffer_size)), count(count){ Link(); }
+
+        /**Allocate the buffers in one block owned by the pool**/
+        BufferPool(int count, size_t buffer_size) : owned(new uint8_t[MemorySize(count, buffer_size)], std::default_delete<uint8_t[]>()),
+                memory(owned.get()), buffer_size(buffer_size), slot_size(MemorySize(1, buffer_size)), count(count){ Link(); }
+
+        BufferPool(const BufferPool&) = delete;
+        BufferPool& operator=(const BufferPool&) = delete;
+
+        /**A free buffer of BufferSize bytes, or nullptr when they are all in use**/
+        ref<uint8_t> Acquire(){
+            if(free_head < 0){
+                exhausted++;
+                return nullptr;
+            }
+            int i = free_head;
+            free_head = Next(i);
+            if(++in_use > high_water)
+                high_water = in_use;
+            acquired++;
+            return ref<uint8_t>(Slot(i) + ControlBytes, NoDelete<uint8_t>(), SlotAllocator<uint8_t>(this, i));
+        }
+
+        inline size_t BufferSize() const { return buffer_size; }
+        inline int Count() const { return count; }
+        inline int InUse() const { return in_use; }
+        inline int Free() const { return count - in_use; }
+        /**Most buffers that were in use at once. Use it to size the pool**/
+        inline int HighWater() const { return high_water; }
+        /**Successful acquires**/
+        inline size_t Acquired() const { return acquired; }
+        /**Acquires that failed because every buffer was in use**/
+        inline size_t Exhausted() const { return exhausted; }
+    };
 }
 #endif
\ No newline at end of file
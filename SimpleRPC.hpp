@@ -0,0 +1,204 @@
+/**********************************************************************
+   NAME: SimpleRPC.hpp
+   AUTHOR: Johnathan Bizzano
+   DATE: 6/22/2023
+
+    The Simple Project
+		Medium Level (from Low) library that abstracts away from embedded device hardware
+
+    Simple RPC
+		Typed messages over a Connection. A message is a one byte id followed by its arguments (WriteStd).
+		The Dispatcher routes a received packet to the Lambda registered for its id through a dense table
+		and decodes the arguments straight out of the packet, never past its end
+*********************************************************************/
+
+#ifndef SIMPLE_RPC_C_H
+#define SIMPLE_RPC_C_H
+
+#include <new>
+#include "SimpleConnection.hpp"
+
+namespace Simple{
+    namespace Internal{
+        /**Decode one message argument from $io. Return false when the packet ends before it (a cut off or foreign message)**/
+        template<typename T> inline bool TryReadArg(IO& io, T* v){
+            if(io.BytesAvailable() < (int) StdWire<T>::Size)
+                return false;
+            io.ReadStd(v);
+            return true;
+        }
+
+        template<typename T> inline typename std::enable_if<std::is_arithmetic<T>::value, bool>::type TryReadArg(IO& io, std::vector<T>* v){
+            uint32_t n;
+            if(!io.TryReadStd(&n) || (uint64_t) n * sizeof(T) > (uint64_t) max(io.BytesAvailable(), 0))
+                return false;
+            v->resize(n);
+            io.ReadStd(v->data(), (int) n);
+            return true;
+        }
+
+        template<typename T> inline typename std::enable_if<!std::is_arithmetic<T>::value, bool>::type TryReadArg(IO& io, std::vector<T>* v){
+            uint32_t n;
+            if(!io.TryReadStd(&n) || n > (uint32_t) max(io.BytesAvailable(), 0))
+                return false;                   //Every element takes a byte at least
+            v->resize(n);
+            for(auto& e : *v)
+                if(!TryReadArg(io, &e))
+                    return false;
+            return true;
+        }
+
+        inline bool TryReadArg(IO& io, std::vector<bool>* v){
+            uint32_t n;
+            if(!io.TryReadStd(&n) || n > (uint32_t) max(io.BytesAvailable(), 0))
+                return false;
+            v->resize(n);
+            for(uint32_t i = 0; i < n; i++)
+                (*v)[i] = io.ReadStd<bool>();
+            return true;
+        }
+
+        template<size_t I = 0, typename... Tp> inline typename std::enable_if<I == sizeof...(Tp), bool>::type TryReadArgs(IO&, tuple<Tp...>&){ return true; }
+        template<size_t I = 0, typename... Tp> inline typename std::enable_if<I < sizeof...(Tp), bool>::type TryReadArgs(IO& io, tuple<Tp...>& t){
+            return TryReadArg(io, &std::get<I>(t)) && TryReadArgs<I + 1, Tp...>(io, t);
+        }
+
+        /**Bytes a message argument takes on the wire**/
+        template<typename T> inline size_t ArgSize(const T&){ return StdWire<T>::Size; }
+        inline size_t ArgSize(const std::vector<bool>& v){ return sizeof(uint32_t) + v.size(); }
+        template<typename T> inline size_t ArgSize(const std::vector<T>& v){
+            size_t n = sizeof(uint32_t);
+            for(auto& e : v)
+                n += ArgSize(e);
+            return n;
+        }
+
+        template<size_t I = 0, typename... Tp> inline typename std::enable_if<I == sizeof...(Tp), size_t>::type ArgsSize(const tuple<Tp...>&){ return 0; }
+        template<size_t I = 0, typename... Tp> inline typename std::enable_if<I < sizeof...(Tp), size_t>::type ArgsSize(const tuple<Tp...>& t){
+            return ArgSize(std::get<I>(t)) + ArgsSize<I + 1, Tp...>(t);
+        }
+    }
+
+    /**A message type: its id on the wire and its arguments
+     * Use it like this
+     *  using SetLed = Message<1, uint8_t, bool>;      //Id 1, led number and state
+     * **/
+    template<uint8_t Id, typename... TArgs> struct Message{
+        static constexpr uint8_t ID = Id;
+        using Args = tuple<TArgs...>;
+        using Handler = Lambda<void(TArgs...)>;
+    };
+
+    /**Routes packets to handlers by message id (O(1), ids below $Count) and sends typed messages on a connection.
+     * Registering, looking up and decoding do not touch the heap (unless an argument type does, like a vector)
+     * Use it like this
+     *  Dispatcher<8> rpc(connection);
+     *  make_local_lambda(set_led, [], void, (uint8_t led, bool on), { ... });
+     *  rpc.On<SetLed>(set_led);
+     *  rpc.Send<SetLed>(3, true);                     //On the other end
+     *  void ReceivedMessage(Packet* p) override { rpc.Dispatch(p); }
+     * **/
+    template<int Count = 32> struct Dispatcher{
+        static_assert(Count > 0 && Count <= 256, "Dispatcher: message ids are one byte");
+    private:
+        using AnyHandler = Lambda<void()>;
+
+        /**A registered handler. The typed Lambda is kept in place and invoke/destroy know its type**/
+        struct Entry{
+            bool (*invoke)(Entry&, IO&) = nullptr;
+            void (*destroy)(Entry&) = nullptr;
+            alignas(AnyHandler) uint8_t handler[sizeof(AnyHandler)];
+        };
+
+        Connection& connection;
+        Packet scratch;
+        Entry table[Count];
+        size_t unhandled = 0, malformed = 0, refused = 0;
+
+        template<typename M> static bool Invoke(Entry& e, IO& io){
+            typename M::Args args;
+            if(!Internal::TryReadArgs(io, args))
+                return false;
+            apply(*(typename M::Handler*) e.handler, args);
+            return true;
+        }
+        template<typename M> static void Destroy(Entry& e){
+            using Handler = typename M::Handler;
+            ((Handler*) e.handler)->~Handler();
+        }
+
+    public:
+        /**Send through $connection. Outgoing messages are written into one buffer of $capacity bytes that is reused**/
+        explicit Dispatcher(Connection& connection, int capacity = 256) : connection(connection), scratch(capacity){}
+
+        Dispatcher(const Dispatcher&) = delete;
+        Dispatcher& operator=(const Dispatcher&) = delete;
+
+        ~Dispatcher(){
+            for(auto& e : table)
+                if(e.destroy != nullptr)
+                    e.destroy(e);
+        }
+
+        /**Call $handler for every received $M. Replaces the handler that was registered for its id**/
+        template<typename M> void On(const typename M::Handler& handler){
+            static_assert(M::ID < Count, "Dispatcher: message id is out of the table");
+            static_assert(sizeof(typename M::Handler) == sizeof(AnyHandler), "Dispatcher: handler does not fit the table");
+            Off<M>();
+            auto& e = table[M::ID];
+            new (e.handler) typename M::Handler(handler);
+            e.invoke = &Invoke<M>;
+            e.destroy = &Destroy<M>;
+        }
+
+        /**Stop handling $M**/
+        template<typename M> void Off(){
+            auto& e = table[M::ID];
+            if(e.destroy != nullptr)
+                e.destroy(e);
+            e.invoke = nullptr;
+            e.destroy = nullptr;
+        }
+
+        /**Decode the message in $p and call its handler. Return false when the id has no handler or the packet is too short
+         * for its arguments (the handler is not called)**/
+        bool Dispatch(Packet* p){
+            uint8_t id;
+            if(!p->TryReadStd(&id) || id >= Count || table[id].invoke == nullptr){
+                unhandled++;
+                return false;
+            }
+            if(!table[id].invoke(table[id], *p)){
+                malformed++;
+                return false;
+            }
+            return true;
+        }
+
+        /**Send $M with $args (converted to the argument types of $M). Return false (see Refused) when it does not fit the buffer
+         * messages are written into**/
+        template<typename M, typename... TArgs> bool Send(TArgs&&... args){
+            static_assert(sizeof...(TArgs) == tuple_size<typename M::Args>::value, "Dispatcher: wrong number of arguments for the message");
+            typename M::Args message(std::forward<TArgs>(args)...);
+            if(sizeof(M::ID) + Internal::ArgsSize(message) > scratch.Capacity()){
+                refused++;
+                return false;
+            }
+            scratch.Clear();
+            scratch.WriteStd(M::ID);
+            scratch.WriteStd(message);
+            scratch.SeekStart();
+            connection.Send(&scratch);
+            return true;
+        }
+
+        /**Received messages whose id had no handler**/
+        inline size_t Unhandled() const { return unhandled; }
+        /**Received messages that ended before their arguments did**/
+        inline size_t Malformed() const { return malformed; }
+        /**Messages Send did not send because they were larger than its buffer**/
+        inline size_t Refused() const { return refused; }
+    };
+}
+
+#endif
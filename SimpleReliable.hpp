@@ -0,0 +1,324 @@
+/**********************************************************************
+   NAME: SimpleReliable.hpp
+   AUTHOR: Johnathan Bizzano
+   DATE: 6/22/2023
+
+    The Simple Project
+		Medium Level (from Low) library that abstracts away from embedded device hardware
+
+    Simple Reliable
+		Sliding window delivery on top of SimpleConnection. Messages get sequence numbers, up to a window of them
+		are in flight at once, the receiver acks them cumulatively and selectively, and the ones not acked in time
+		are sent again from a Timer
+*********************************************************************/
+
+#ifndef SIMPLE_RELIABLE_C_H
+#define SIMPLE_RELIABLE_C_H
+
+#include "SimpleConnection.hpp"
+
+namespace Simple{
+    /**SimpleConnection that delivers every message exactly once, in order if $ordered. Each message is kept until it is acked and
+     * sent again when it is not acked within the retransmission timeout (estimated from the round trips) or when three acks
+     * show it missing. Several messages are in flight at once, so a long round trip does not idle the link.
+     * Acks go out once per Receive, so a chunk with many frames is acked once. Both ends need the same window and framing.
+     * The timeouts run on a Timer, so the tasks have to be yielded
+     *
+     * On the wire every message starts with its kind. Data: kind, sequence (uint16_t) then the payload.
+     * Ack: kind, the next sequence expected (uint16_t) and a bitmap (uint64_t) of the 64 that follow that have arrived
+     * Use it like this
+     *  struct Link : ReliableConnection { ... void ReceivedMessage(Packet* p) override { ... } };
+     *  if(link.Room() > 0) link.Send(&p);
+     * **/
+    class ReliableConnection : public SimpleConnection{
+    public:
+        /**Largest window (the selective ack covers the 64 messages after the first missing one)**/
+        static constexpr int MaxWindow = 64;
+        /**Bytes every message takes in front of its payload**/
+        static constexpr int HeaderSize = 1 + sizeof(uint16_t);
+
+    private:
+        enum class Kind : uint8_t { Data = 0, Ack = 1 };
+
+        struct Slot{
+            uint32_t sent = 0;
+            uint32_t length = 0;
+            uint8_t retries = 0;
+            uint8_t missed = 0;         //Acks that showed it missing (it is resent early once, at 3)
+            bool acked = false;
+        };
+
+        int window, slot_size;
+        bool ordered;
+
+        //Sender: the messages from send_base to send_next are in flight, send_base in slot send_slot
+        Slot sent[MaxWindow];
+        ref<uint8_t> send_memory;
+        uint16_t send_base = 0, send_next = 0;
+        int send_slot = 0;
+        Timer retransmit_timer;
+        uint32_t rto, min_rto, max_rto;
+        int32_t srtt = -1, rttvar = 0;
+        size_t retransmits = 0, refused = 0;
+
+        //Receiver: recv_next is the next message to deliver (in slot recv_slot), bit i of arrived is recv_next + 1 + i
+        uint32_t recv_lengths[MaxWindow];
+        ref<uint8_t> recv_memory;
+        uint16_t recv_next = 0;
+        int recv_slot = 0;
+        uint64_t arrived = 0;
+        bool ack_pending = false;
+        size_t duplicates = 0;
+
+        inline uint8_t* SendSlot(int i){ return send_memory.get() + (size_t) i * slot_size; }
+        inline uint8_t* RecvSlot(int i){ return recv_memory.get() + (size_t) i * slot_size; }
+        inline int SlotOf(int base, int delta) const { return (base + delta) % window; }
+
+    public:
+        /**Up to $window messages (at most MaxWindow) in flight. The other arguments are the framing of SimpleConnection, a checksum is
+         * on by default since a corrupt message would otherwise be acked and delivered. Takes two buffers of $window payloads.
+         * A $capacity whose MaxPayload cannot hold an ack gets a Window of 0, it refuses every message**/
+        explicit ReliableConnection(int window = 16, bool ordered = true, int capacity = 256, FrameCheck check = FrameCheck::CRC16,
+                                    FrameLength length_field = FrameLength::Byte)
+            : SimpleConnection(capacity, check, length_field), window(max(1, min(window, (int) MaxWindow))), ordered(ordered),
+              retransmit_timer(true, 0), rto(500), min_rto(10), max_rto(10000){
+            slot_size = MaxPayload();
+            lazyassert(slot_size >= HeaderSize + (int) sizeof(uint64_t), "ReliableConnection: the capacity cannot hold an ack");
+            if(slot_size < HeaderSize + (int) sizeof(uint64_t)){
+                this->window = 0;
+                slot_size = 0;
+            }
+            send_memory.reset(new uint8_t[(size_t) this->window * slot_size], default_delete<uint8_t[]>());
+            if(ordered)
+                recv_memory.reset(new uint8_t[(size_t) this->window * slot_size], default_delete<uint8_t[]>());
+            retransmit_timer.callback = GlobalLambda<void(Timer&)>([this](Timer&){ Retransmit(); });
+            SetTimer();
+        }
+
+        ReliableConnection(const ReliableConnection&) = delete;
+        ReliableConnection& operator=(const ReliableConnection&) = delete;
+
+        /**Send the payload of $p (cut off at MaxMessage) once there is room in the window. The message is copied, $p can be reused
+         * at once. Return false (leaving $p alone) when the window is full**/
+        bool TrySend(Packet* p){
+            if(InFlight() >= window)
+                return false;
+            auto i = SlotOf(send_slot, InFlight());
+            auto length = min(p->BytesAvailable(), MaxMessage());
+            auto slot = SendSlot(i);
+            slot[0] = (uint8_t) Kind::Data;
+            StoreStd(slot + 1, send_next);
+            memcpy(slot + HeaderSize, p->Interpret(), length);
+            p->SeekDelta(length);
+            sent[i] = Slot();
+            sent[i].length = HeaderSize + length;
+            send_next++;
+            Transmit(i);
+            if(!retransmit_timer.Active()){
+                retransmit_timer.Repeat = true;
+                retransmit_timer.Start();
+            }
+            return true;
+        }
+
+        /**Like TrySend. A message that does not fit in the window is dropped (see Refused), check Room first**/
+        void Send(Packet* p) override {
+            if(!TrySend(p))
+                refused++;
+        }
+
+        /**Buffer the chunk, hand out the messages it completes and ack them (one ack for the whole chunk)**/
+        void Receive(Packet* io) override {
+            SimpleConnection::Receive(io);
+            if(ack_pending)
+                SendAck();
+        }
+
+        /**Forget everything in flight and start the sequence again. Both ends have to reset**/
+        void Reset(){
+            send_base = send_next = recv_next = 0;
+            send_slot = recv_slot = 0;
+            arrived = 0;
+            ack_pending = false;
+            retransmit_timer.Stop();
+        }
+
+        /**Set the retransmission timeout used before a round trip was measured ($initial) and the bounds of the estimate (ms)**/
+        void SetTimeout(uint32_t initial, uint32_t minimum = 10, uint32_t maximum = 10000){
+            min_rto = max(minimum, (uint32_t) 1);
+            max_rto = max(maximum, min_rto);
+            rto = min(max(initial, min_rto), max_rto);
+            srtt = -1;
+            SetTimer();
+        }
+
+        /**Largest payload of a message**/
+        inline int MaxMessage() const { return slot_size - HeaderSize; }
+        inline int Window() const { return window; }
+        inline bool Ordered() const { return ordered; }
+        /**Messages sent and not acked yet**/
+        inline int InFlight() const { return (uint16_t) (send_next - send_base); }
+        /**Messages that can be sent before the window is full**/
+        inline int Room() const { return window - InFlight(); }
+        /**Current retransmission timeout (ms)**/
+        inline uint32_t Timeout() const { return rto; }
+        inline size_t Retransmits() const { return retransmits; }
+        /**Messages Send dropped because the window was full**/
+        inline size_t Refused() const { return refused; }
+        /**Messages that arrived again (their ack was lost or they were resent early)**/
+        inline size_t Duplicates() const { return duplicates; }
+
+    protected:
+        void Accept(Packet* p) override {
+            uint8_t kind;
+            uint16_t seq;
+            if(!p->TryReadStd(&kind) || !p->TryReadStd(&seq))
+                return;
+            if(kind == (uint8_t) Kind::Data)
+                Arrived(seq, p);
+            else if(kind == (uint8_t) Kind::Ack){
+                uint64_t bits;
+                if(p->TryReadStd(&bits))
+                    Acked(seq, bits);
+            }
+        }
+
+    private:
+        void Transmit(int i){
+            sent[i].sent = Clock.Millis();
+            Packet view(IOArray(ref<uint8_t>(send_memory, SendSlot(i)), sent[i].length, sent[i].length));
+            SimpleConnection::Send(&view);
+        }
+
+        /**Poll the timeouts a few times per timeout**/
+        void SetTimer(){
+            retransmit_timer.length = max(rto / 4, (uint32_t) 1);
+        }
+
+        /**Send again every message whose timeout ran out and back the timeout off. Stops the timer once nothing is in flight**/
+        void Retransmit(){
+            auto now = Clock.Millis();
+            auto expired = false;
+            for(int d = 0; d < InFlight(); d++){
+                auto i = SlotOf(send_slot, d);
+                if(sent[i].acked || now - sent[i].sent < rto)
+                    continue;
+                if(sent[i].retries < 0xFF)
+                    sent[i].retries++;
+                retransmits++;
+                expired = true;
+                Transmit(i);
+            }
+            if(expired){
+                rto = min(rto * 2, max_rto);
+                SetTimer();
+            }
+            retransmit_timer.Repeat = InFlight() > 0;
+        }
+
+        /**Update the round trip estimate (RFC 6298) with a message that was sent once**/
+        void Measure(const Slot& s){
+            if(s.retries > 0)
+                return;                 //Karn: it is unknown which copy was acked
+            auto r = (int32_t) (Clock.Millis() - s.sent);
+            if(srtt < 0){
+                srtt = r;
+                rttvar = r / 2;
+            }else{
+                rttvar = (3 * rttvar + abs(srtt - r)) / 4;
+                srtt = (7 * srtt + r) / 8;
+            }
+            rto = min(max((uint32_t) (srtt + max(4 * rttvar, (int32_t) 1)), min_rto), max_rto);
+            SetTimer();
+        }
+
+        void Acked(uint16_t next, uint64_t bits){
+            auto flight = InFlight();
+            auto cumulative = (uint16_t) (next - send_base);
+            if(cumulative > flight)
+                return;                 //Stale or broken
+            for(int d = 0; d < flight; d++){
+                auto i = SlotOf(send_slot, d);
+                if(sent[i].acked)
+                    continue;
+                auto after = d - cumulative - 1;          //Bit of this message in the selective ack
+                if(d < cumulative || (after >= 0 && after < 64 && (bits >> after) & 1)){
+                    sent[i].acked = true;
+                    Measure(sent[i]);
+                }
+            }
+            //The receiver is stuck at $next while later ones arrive, resend it without waiting for the timeout
+            if(bits != 0 && cumulative < flight){
+                auto i = SlotOf(send_slot, cumulative);
+                if(!sent[i].acked && ++sent[i].missed == 3){
+                    retransmits++;
+                    if(sent[i].retries < 0xFF)
+                        sent[i].retries++;
+                    Transmit(i);
+                }
+            }
+            while(InFlight() > 0 && sent[send_slot].acked){
+                send_base++;
+                send_slot = SlotOf(send_slot, 1);
+            }
+            if(InFlight() == 0)
+                retransmit_timer.Stop();
+        }
+
+        void Arrived(uint16_t seq, Packet* p){
+            ack_pending = true;
+            auto d = (uint16_t) (seq - recv_next);
+            if(d >= window){
+                duplicates += d >= 0x8000;      //Behind the window it was delivered already, ahead of it it is dropped
+                return;
+            }
+            if(d > 0){
+                auto bit = (uint64_t) 1 << (d - 1);
+                if(arrived & bit){
+                    duplicates++;
+                    return;
+                }
+                arrived |= bit;
+                if(!ordered)
+                    ReceivedMessage(p);
+                else{
+                    auto i = SlotOf(recv_slot, d);
+                    recv_lengths[i] = p->BytesAvailable();
+                    memcpy(RecvSlot(i), p->Interpret(), recv_lengths[i]);
+                }
+                return;
+            }
+
+            ReceivedMessage(p);
+            auto next = true;
+            while(next){
+                next = arrived & 1;
+                arrived >>= 1;
+                recv_next++;
+                recv_slot = SlotOf(recv_slot, 1);
+                if(next && ordered){
+                    Packet view(IOArray(ref<uint8_t>(recv_memory, RecvSlot(recv_slot)), recv_lengths[recv_slot], recv_lengths[recv_slot]));
+                    ReceivedMessage(&view);
+                }
+            }
+            if(ordered && recv_memory.use_count() > 1){
+                //A delivered message was kept, move the waiting ones to fresh storage instead of overwriting it
+                auto fresh = ref<uint8_t>(new uint8_t[(size_t) window * slot_size], default_delete<uint8_t[]>());
+                memcpy(fresh.get(), recv_memory.get(), (size_t) window * slot_size);
+                recv_memory = std::move(fresh);
+            }
+        }
+
+        void SendAck(){
+            ack_pending = false;
+            uint8_t ack[HeaderSize + sizeof(uint64_t)];
+            ack[0] = (uint8_t) Kind::Ack;
+            StoreStd(ack + 1, recv_next);
+            StoreStd(ack + HeaderSize, arrived);
+            Packet view(IOArray(ref<uint8_t>(ref<uint8_t>(), ack), sizeof(ack), sizeof(ack)));     //Not owned, sent before it goes away
+            SimpleConnection::Send(&view);
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,156 @@
+/**********************************************************************
+   NAME: SimpleSchema.hpp
+   AUTHOR: Johnathan Bizzano
+   DATE: 6/22/2023
+
+    The Simple Project
+		Medium Level (from Low) library that abstracts away from embedded device hardware
+
+    Simple Schema
+		Declarative serialization for fixed layout structs. Fields are registered once with SIMPLE_SCHEMA
+		which generates a constexpr wire size and straight-line encode/decode used by WriteStd/ReadStd.
+		Read only views that decode wire values in place, on access
+*********************************************************************/
+
+#ifndef SIMPLE_SCHEMA_C_H
+#define SIMPLE_SCHEMA_C_H
+
+#include <type_traits>
+#include <array>
+#include "SimpleUtils.hpp"
+#include "SimpleBytes.hpp"
+
+namespace Simple{
+    /**Returned for types that do not have a SIMPLE_SCHEMA**/
+    struct NoSchema{};
+    NoSchema __simple_schema__(...);
+
+    /**The schema generated by SIMPLE_SCHEMA for $T (found by argument dependent lookup)**/
+    template<typename T> using SchemaOf = decltype(__simple_schema__((T*) nullptr));
+
+    template<typename T> struct HasSchema : std::integral_constant<bool, !std::is_same<SchemaOf<T>, NoSchema>::value>{};
+
+    /**Fixed size wire codec of a schema field. Arithmetic, enum, std::array and schema types are supported**/
+    template<typename T, typename Enable = void> struct StdWire{};
+
+    template<typename T> struct StdWire<T, typename std::enable_if<std::is_arithmetic<T>::value>::type>{
+        static constexpr size_t Size = sizeof(T);
+        static inline uint8_t* Encode(uint8_t* dst, const T& v){ StoreStd<T>(dst, v); return dst + Size; }
+        static inline const uint8_t* Decode(const uint8_t* src, T& v){ v = LoadStd<T>(src); return src + Size; }
+    };
+
+    template<typename T> struct StdWire<T, typename std::enable_if<std::is_enum<T>::value>::type>{
+        using U = typename std::underlying_type<T>::type;
+        static constexpr size_t Size = sizeof(U);
+        static inline uint8_t* Encode(uint8_t* dst, const T& v){ StoreStd<U>(dst, (U) v); return dst + Size; }
+        static inline const uint8_t* Decode(const uint8_t* src, T& v){ v = (T) LoadStd<U>(src); return src + Size; }
+    };
+
+    template<typename T, size_t S> struct StdWire<std::array<T, S>>{
+        static constexpr size_t Size = S * StdWire<T>::Size;
+        static inline uint8_t* Encode(uint8_t* dst, const std::array<T, S>& v){
+            for(size_t i = 0; i < S; i++)
+                dst = StdWire<T>::Encode(dst, v[i]);
+            return dst;
+        }
+        static inline const uint8_t* Decode(const uint8_t* src, std::array<T, S>& v){
+            for(size_t i = 0; i < S; i++)
+                src = StdWire<T>::Decode(src, v[i]);
+            return src;
+        }
+    };
+
+    template<typename T> struct StdWire<T, typename std::enable_if<HasSchema<T>::value>::type> : public SchemaOf<T>{};
+
+    /**Read only view of one wire value in a buffer. Nothing is decoded until the value is read. The buffer must outlive the view**/
+    template<typename T> struct StdView{
+        const uint8_t* data = nullptr;
+
+        StdView(){}
+        explicit StdView(const uint8_t* data) : data(data){}
+
+        inline bool Valid() const { return data != nullptr; }
+
+        inline T Get() const {
+            T v;
+            StdWire<T>::Decode(data, v);
+            return v;
+        }
+
+        inline operator T() const { return Get(); }
+    };
+
+    /**Read only view of an array of fixed size wire values in a buffer (the elements of a vector written with WriteStd).
+     * Elements are decoded one at a time on access, so reading a few of them costs O(1). The buffer must outlive the view**/
+    template<typename T> struct StdArrayView{
+        const uint8_t* data = nullptr;
+        uint32_t size = 0;
+
+        struct Iterator{
+            const uint8_t* p;
+            inline T operator*() const { T v; StdWire<T>::Decode(p, v); return v; }
+            inline Iterator& operator++(){ p += StdWire<T>::Size; return *this; }
+            inline bool operator!=(const Iterator& o) const { return p != o.p; }
+        };
+
+        StdArrayView(){}
+        StdArrayView(const uint8_t* data, uint32_t size) : data(data), size(size){}
+
+        inline bool Valid() const { return data != nullptr; }
+        inline bool Empty() const { return size == 0; }
+        /**Bytes the elements take on the wire**/
+        inline size_t WireSize() const { return size * StdWire<T>::Size; }
+
+        inline T operator[](size_t i) const {
+            T v;
+            StdWire<T>::Decode(data + i * StdWire<T>::Size, v);
+            return v;
+        }
+
+        inline StdView<T> At(size_t i) const { return StdView<T>(data + i * StdWire<T>::Size); }
+
+        inline Iterator begin() const { return {data}; }
+        inline Iterator end() const { return {data + WireSize()}; }
+
+        /**Decode $count elements starting at $offset to $dst. Arithmetic elements are byte swapped in bulk**/
+        void CopyTo(T* dst, size_t offset, size_t count) const { CopyTo(dst, offset, count, 0); }
+        void CopyTo(T* dst) const { CopyTo(dst, 0, size); }
+
+    private:
+        template<typename U = T> typename std::enable_if<std::is_arithmetic<U>::value && !std::is_same<U, bool>::value, void>::type
+        CopyTo(T* dst, size_t offset, size_t count, int) const { ToStdBytes((uint8_t*) dst, data + offset * sizeof(T), (int) count, sizeof(T)); }
+
+        void CopyTo(T* dst, size_t offset, size_t count, long) const {
+            for(size_t i = 0; i < count; i++)
+                dst[i] = (*this)[offset + i];
+        }
+    };
+}
+
+#define __SIMPLE_SCHEMA_SIZE__(type, field) + Simple::StdWire<decltype(type::field)>::Size
+#define __SIMPLE_SCHEMA_ENCODE__(type, field) dst = Simple::StdWire<decltype(type::field)>::Encode(dst, v.field);
+#define __SIMPLE_SCHEMA_DECODE__(type, field) src = Simple::StdWire<decltype(type::field)>::Decode(src, v.field);
+
+/**Register the fields of a struct for WriteStd/ReadStd. Use it in the namespace of the struct after its definition
+ * Use it like this
+ *  struct Sensor{ uint32_t time; float x, y, z; };
+ *  SIMPLE_SCHEMA(Sensor, time, x, y, z)
+ *  io.WriteStd(sensor);    //One WriteBytes of Sensor_SimpleSchema::WireSize bytes
+ *  io.ReadStd(&sensor);
+ * **/
+#define SIMPLE_SCHEMA(type, ...)                                                                              \
+    struct CAT(type, _SimpleSchema){                                                                          \
+        static constexpr size_t WireSize = 0 FOR_EACH(__SIMPLE_SCHEMA_SIZE__, type, __VA_ARGS__);              \
+        static constexpr size_t Size = WireSize;                                                              \
+        static inline uint8_t* Encode(uint8_t* dst, const type& v){                                           \
+            FOR_EACH(__SIMPLE_SCHEMA_ENCODE__, type, __VA_ARGS__)                                             \
+            return dst;                                                                                       \
+        }                                                                                                     \
+        static inline const uint8_t* Decode(const uint8_t* src, type& v){                                     \
+            FOR_EACH(__SIMPLE_SCHEMA_DECODE__, type, __VA_ARGS__)                                             \
+            return src;                                                                                       \
+        }                                                                                                     \
+    };                                                                                                        \
+    inline CAT(type, _SimpleSchema) __simple_schema__(type*){ return CAT(type, _SimpleSchema)(); }
+
+#endif
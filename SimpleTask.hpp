@@ -51,6 +51,8 @@ namespace Simple{
         virtual void Stop(){
             if(Active()){
                 tasks.erase(tasks.begin() + ID);
+                for(size_t i = ID; i < tasks.size(); i++)
+                    tasks[i]->ID = (int) i;     //Later tasks moved down a slot
                 ID = -1;
             }
         }
@@ -20,6 +20,29 @@
 #define _CAT2(x, y, z) x ## y ## z
 #define CAT2(x, y, z) _CAT2(x, y, z)
 
+//Count the arguments of a macro (1 to 16)
+#define NARGS(...) _NARGS(__VA_ARGS__, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1)
+#define _NARGS(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, N, ...) N
+
+//Apply m(data, x) to every argument x (1 to 16 arguments)
+#define FOR_EACH(m, data, ...) CAT(_FOR_EACH, NARGS(__VA_ARGS__))(m, data, __VA_ARGS__)
+#define _FOR_EACH1(m, d, x) m(d, x)
+#define _FOR_EACH2(m, d, x, ...) m(d, x) _FOR_EACH1(m, d, __VA_ARGS__)
+#define _FOR_EACH3(m, d, x, ...) m(d, x) _FOR_EACH2(m, d, __VA_ARGS__)
+#define _FOR_EACH4(m, d, x, ...) m(d, x) _FOR_EACH3(m, d, __VA_ARGS__)
+#define _FOR_EACH5(m, d, x, ...) m(d, x) _FOR_EACH4(m, d, __VA_ARGS__)
+#define _FOR_EACH6(m, d, x, ...) m(d, x) _FOR_EACH5(m, d, __VA_ARGS__)
+#define _FOR_EACH7(m, d, x, ...) m(d, x) _FOR_EACH6(m, d, __VA_ARGS__)
+#define _FOR_EACH8(m, d, x, ...) m(d, x) _FOR_EACH7(m, d, __VA_ARGS__)
+#define _FOR_EACH9(m, d, x, ...) m(d, x) _FOR_EACH8(m, d, __VA_ARGS__)
+#define _FOR_EACH10(m, d, x, ...) m(d, x) _FOR_EACH9(m, d, __VA_ARGS__)
+#define _FOR_EACH11(m, d, x, ...) m(d, x) _FOR_EACH10(m, d, __VA_ARGS__)
+#define _FOR_EACH12(m, d, x, ...) m(d, x) _FOR_EACH11(m, d, __VA_ARGS__)
+#define _FOR_EACH13(m, d, x, ...) m(d, x) _FOR_EACH12(m, d, __VA_ARGS__)
+#define _FOR_EACH14(m, d, x, ...) m(d, x) _FOR_EACH13(m, d, __VA_ARGS__)
+#define _FOR_EACH15(m, d, x, ...) m(d, x) _FOR_EACH14(m, d, __VA_ARGS__)
+#define _FOR_EACH16(m, d, x, ...) m(d, x) _FOR_EACH15(m, d, __VA_ARGS__)
+
 #define SetBit(x, n, v) ((v) ? ((x) | (1<<(n))) : ((x) & ~(1<<(n))))
 #define GetBit(x, n) ((x) & (1<<(n)))
 
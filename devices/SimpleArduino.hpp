@@ -42,15 +42,14 @@ namespace Simple{
 
         explicit SerialConnection(int capacity = 256) : p(capacity){}
 
+        /**Read into a buffer from $pool (a heap buffer of $capacity when it is exhausted)**/
+        explicit SerialConnection(PacketPool& pool, int capacity = 256) : p(pool.Take(capacity)){}
+
         TaskReturn Fire() override{
             while(Serial.available() > 0){
-                p.SeekStart();
                 int nbytes = Serial.readBytes((char*) p.Interpret(0), p.Capacity());
-                auto ps = p.Size();
-
-                p.SetSize(nbytes);
-                Receive(&p);
-                p.SetSize(ps);
+                Packet chunk(p.Slice(0, nbytes));
+                Receive(&chunk);
             }
             return TaskReturn::Nothing;
         }
@@ -62,6 +61,11 @@ namespace Simple{
                 Serial.write(buf, nbytes);
             }
         }
+
+        void WriteV(const Span* parts, int count) override {
+            for(int i = 0; i < count; i++)
+                Serial.write(parts[i].data, parts[i].length);
+        }
     };
 }
 
@@ -43,12 +43,17 @@ namespace Simple{
     protected:
         RH_RF95 rf95;
         const uint8_t resetPin;
+        Compressor* compressor = nullptr;
+        RadioPacket inflated;
 
     public:
+        /**Header flag of a message whose payload is compressed**/
+        static constexpr uint8_t CompressedFlag = 0x01;
+
         RadioPacket buffer;
 
         RadioConnection(uint8_t slaveSelectPin, uint8_t interruptPin, uint8_t resetPin, int buffer) :
-            rf95(slaveSelectPin, interruptPin), resetPin(resetPin), buffer(RH_RF95_MAX_MESSAGE_LEN){
+            rf95(slaveSelectPin, interruptPin), resetPin(resetPin), inflated(0), buffer(RH_RF95_MAX_MESSAGE_LEN){
             pinMode(resetPin, OUTPUT);
             digitalWrite(resetPin, HIGH);
         }
@@ -86,9 +91,29 @@ namespace Simple{
             return true;
         }
 
+        /**Compress the payloads with $compressor (nullptr turns it off) to save airtime. A compressed message is marked with
+         * CompressedFlag in the radio header, so one that does not get smaller is sent as it is. Messages of up to $capacity bytes
+         * can be received (more than RH_RF95_MAX_MESSAGE_LEN when they compress). Both ends need it with the same dictionary**/
+        void Compress(Compressor* compressor, int capacity = 4 * RH_RF95_MAX_MESSAGE_LEN){
+            this->compressor = compressor;
+            if(compressor != nullptr && (int) inflated.Capacity() < capacity)
+                inflated = RadioPacket(capacity);
+        }
+
         void Send(Packet* p) override{
             rf95.setHeaderTo(((RadioPacket*) p)->to);
             rf95.setHeaderId(((RadioPacket*) p)->id);
+            if(compressor != nullptr && p->BytesAvailable() > 1){
+                auto length = p->BytesAvailable();
+                auto n = compressor->Compress(p->Interpret(), length, buffer.Interpret(0), min(length - 1, RH_RF95_MAX_MESSAGE_LEN));
+                if(n > 0){
+                    rf95.setHeaderFlags(CompressedFlag, CompressedFlag);
+                    rf95.send(buffer.Interpret(0), n);
+                    p->SeekDelta(length);
+                    return;
+                }
+            }
+            rf95.setHeaderFlags(0, CompressedFlag);
             Write(p);
         }
 
@@ -105,12 +130,32 @@ namespace Simple{
                 buffer.from = rf95.headerFrom();
                 buffer.id = rf95.headerId();
                 buffer.SeekStart();
-                Receive(&buffer);
+                if(rf95.headerFlags() & CompressedFlag)
+                    ReceiveCompressed();
+                else
+                    Receive(&buffer);
                 buffer.SetSize(RH_RF95_MAX_MESSAGE_LEN);
             }
             return TaskReturn::Nothing;
         }
         void SetAddress(int id){ rf95.setThisAddress(id); }
+
+    private:
+        /**Decompress the received message into its own buffer and receive that. Dropped without a compressor or when it is broken**/
+        void ReceiveCompressed(){
+            if(compressor == nullptr)
+                return;
+            auto n = compressor->Decompress(buffer.Interpret(0), buffer.Size(), inflated.Interpret(0), inflated.Capacity());
+            if(n < 0)
+                return;
+            inflated.Clear();
+            inflated.SetSize(n);
+            inflated.from = buffer.from;
+            inflated.id = buffer.id;
+            Receive(&inflated);
+        }
+
+    public:
         void Receive(Packet* p) final { Receive((RadioPacket*) p); }
         virtual void Receive(RadioPacket* rp) = 0;
     };
@@ -15,7 +15,22 @@
 
 #include "../SimpleIO.hpp"
 #include "../SimpleTimer.hpp"
+#include "../SimpleConnection.hpp"
 #include <chrono>
+#include <climits>
+
+#ifdef SIMPLE_POSIX
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <sys/ioctl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <netinet/in.h>
+    #include <netdb.h>
+#endif
 
 using namespace std;
 using namespace std::chrono;
@@ -28,6 +43,633 @@ time_t Simple::NativeMillis(){
 FileIO Out(stdout, stdin);
 FileIO Error(stderr, nullptr);
 
+#ifdef SIMPLE_POSIX
+namespace Simple{
+    /**IO over POSIX file descriptors (pipes, sockets, ttys, files) with a user space write buffer.
+     * Reads never block, so it can be polled from a Task. Writes are buffered until the buffer fills or Flush is called**/
+    struct FdIO : public IO{
+        int out, in;
+    private:
+        ref<uint8_t> buffer;
+        int capacity, length = 0;
+
+        /**Write everything, waiting for the fd when it is non blocking and full. Return the bytes written (less on an error)**/
+        int WriteAll(const uint8_t* ptr, int nbytes){
+            int written = 0;
+            while(written < nbytes){
+                auto n = write(out, ptr + written, nbytes - written);
+                if(n < 0){
+                    if(errno == EINTR) continue;
+                    if(errno == EAGAIN || errno == EWOULDBLOCK){
+                        pollfd p = {out, POLLOUT, 0};
+                        poll(&p, 1, -1);
+                        continue;
+                    }
+                    break;
+                }
+                written += (int) n;
+            }
+            return written;
+        }
+
+        /**Keep the $n bytes at $ptr (the end of the buffer that could not be written) at the front of the write buffer**/
+        void Keep(const uint8_t* ptr, int n){
+            if(n > 0)
+                memmove(buffer.get(), ptr, n);
+            length = n;
+        }
+
+    public:
+        /**$buffer_size of 0 writes straight through. $nonblocking puts $in in non blocking mode**/
+        FdIO(int out, int in, int buffer_size = BUFSIZ, bool nonblocking = true) : out(out), in(in), capacity(0){
+            SetBuffer(buffer_size);
+            if(nonblocking && in >= 0)
+                fcntl(in, F_SETFL, fcntl(in, F_GETFL) | O_NONBLOCK);
+        }
+
+        FdIO(const FdIO&) = delete;
+        FdIO& operator=(const FdIO&) = delete;
+
+        ~FdIO(){ Flush(); }
+
+        /**Flush and resize the user space write buffer. Bytes that could not be flushed are lost**/
+        void SetBuffer(int buffer_size){
+            Flush();
+            capacity = buffer_size;
+            buffer.reset(buffer_size > 0 ? new uint8_t[buffer_size] : nullptr, default_delete<uint8_t[]>());
+        }
+
+        /**Write the buffered bytes to the fd. Return if it succeeded, otherwise the bytes that were not written stay buffered**/
+        bool Flush(){
+            auto n = WriteAll(buffer.get(), length);
+            Keep(buffer.get() + n, length - n);
+            return length == 0;
+        }
+
+        inline int Buffered() const { return length; }
+
+        /**Room in the write buffer, so a source without exposed memory is read straight into it**/
+        Span PrepareWriteSpan(int n) final {
+            if(length == capacity)
+                Flush();
+            return {buffer.get() + length, min(n, capacity - length)};
+        }
+        void CommitWrite(int n) final { length += n; }
+
+        /**Bytes that can be read without blocking (FIONREAD, falls back to poll which can only tell 0 or 1)**/
+        int BytesAvailable() final {
+            if(in < 0)
+                return 0;
+            int n = 0;
+            if(ioctl(in, FIONREAD, &n) == 0)
+                return n;
+            pollfd p = {in, POLLIN, 0};
+            return poll(&p, 1, 0) > 0 && (p.revents & POLLIN) ? 1 : 0;
+        }
+
+        int ReadBytesUnlocked(uint8_t *ptr, int buffer_size) final {
+            if(in < 0)
+                return 0;
+            while(true){
+                auto n = read(in, ptr, buffer_size);
+                if(n >= 0)
+                    return (int) n;
+                if(errno != EINTR)
+                    return 0;       //EAGAIN (nothing to read) or an error
+            }
+        }
+
+        int WriteBytes(uint8_t *ptr, int nbytes) final {
+            if(nbytes <= 0)
+                return 0;
+            if(length + nbytes > capacity){
+                if(!Flush())
+                    return 0;
+                if(nbytes >= capacity)
+                    return WriteAll(ptr, nbytes);
+            }
+            memcpy(buffer.get() + length, ptr, nbytes);
+            length += nbytes;
+            return nbytes;
+        }
+
+        /**Gather into the write buffer when it fits, otherwise one writev with the buffered bytes in front**/
+        int WriteBytesV(const Span* parts, int count) final {
+            int total = 0;
+            for(int i = 0; i < count; i++)
+                total += parts[i].length;
+            if(length + total <= capacity || count > 15)
+                return IO::WriteBytesV(parts, count);
+
+            struct iovec iov[16];
+            int n = 0;
+            if(length > 0)
+                iov[n++] = {buffer.get(), (size_t) length};
+            for(int i = 0; i < count; i++)
+                iov[n++] = {parts[i].data, (size_t) parts[i].length};
+
+            ssize_t written;
+            while((written = writev(out, iov, n)) < 0 && errno == EINTR);
+            if(written < 0)
+                written = 0;        //Non blocking and full, or an error: WriteAll below waits or fails
+            //Finish a partial writev. Return the bytes of $parts actually written (not the buffered ones), stopping at a failed write.
+            //Buffered bytes that could not be written stay buffered
+            int first = length > 0 ? 1 : 0, done = 0;
+            length = 0;
+            for(int i = 0; i < n; i++){
+                auto base = (uint8_t*) iov[i].iov_base;
+                auto len = (int) iov[i].iov_len;
+                auto head = (int) min(written, (ssize_t) len);
+                auto sent = head + (head < len ? WriteAll(base + head, len - head) : 0);
+                written -= head;
+                if(i >= first)
+                    done += sent;
+                else if(sent < len)
+                    Keep(base + sent, len - sent);
+                if(sent < len)
+                    break;
+            }
+            return done;
+        }
+    };
+
+    /**Read only or read write memory map of a file as a SeekableIO. Seek is O(1), reads are a memcpy out of the page cache and
+     * Interpret/Slice hand out pointers and packets straight into the mapping, so recorded logs can be parsed without copies**/
+    struct MappedFileIO : public SeekableIO{
+        enum Advice { Normal = MADV_NORMAL, Sequential = MADV_SEQUENTIAL, Random = MADV_RANDOM, WillNeed = MADV_WILLNEED };
+    private:
+        ref<uint8_t> memory;
+        size_t position = 0, size = 0;
+        bool writable = false;
+
+        /**Bytes after the position. BytesAvailable is an int, maps of more than 2 GB count in size_t and clamp**/
+        inline int Remaining() const { return (int) min(position < size ? size - position : 0, (size_t) INT_MAX); }
+    public:
+        MappedFileIO(){}
+
+        /**Map $path. A writable map of a new or smaller file is grown to $size bytes**/
+        explicit MappedFileIO(const char* path, bool writable = false, size_t size = 0, Advice advice = Sequential){ Open(path, writable, size, advice); }
+
+        /**Map $path. A writable map of a new or smaller file is grown to $size bytes. Return if it succeeded (an empty file
+         * cannot be mapped)**/
+        bool Open(const char* path, bool writable = false, size_t size = 0, Advice advice = Sequential){
+            Close();
+            int fd = open(path, writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+            if(fd < 0)
+                return false;
+            struct stat st;
+            if(fstat(fd, &st) != 0 || (writable && (size_t) st.st_size < size && ftruncate(fd, size) != 0)){
+                close(fd);
+                return false;
+            }
+            auto length = max(size, (size_t) st.st_size);
+            auto p = length > 0 ? mmap(nullptr, length, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+            if(p == MAP_FAILED){
+                close(fd);
+                return false;
+            }
+            memory.reset((uint8_t*) p, [length](uint8_t* m){ munmap(m, length); });
+            close(fd);                      //The mapping keeps the file open
+            this->size = length;
+            this->writable = writable;
+            Advise(advice);
+            return true;
+        }
+
+        /**Unmap the file. Slices that were handed out keep the mapping alive until they are gone**/
+        void Close(){
+            memory.reset();
+            position = size = 0;
+        }
+
+        inline bool IsOpen() const { return memory != nullptr; }
+
+        /**Tell the kernel how the range will be read (Sequential read ahead, WillNeed prefetch, ...). $length 0 means to the end**/
+        void Advise(Advice advice, size_t offset = 0, size_t length = 0){
+            if(IsOpen() && offset < size)
+                madvise(memory.get() + offset, length == 0 ? size - offset : min(length, size - offset), advice);
+        }
+
+        Span PeekReadSpan() final { return {memory.get() + position, Remaining()}; }
+        void CommitRead(int n) final { position += n; }
+        Span PrepareWriteSpan(int n) final { return {memory.get() + position, writable ? min(n, Remaining()) : 0}; }
+        void CommitWrite(int n) final { position += n; }
+
+        /**Write the dirty pages of a writable map back to the file**/
+        bool Flush(bool async = false){ return !IsOpen() || msync(memory.get(), size, async ? MS_ASYNC : MS_SYNC) == 0; }
+
+        void Seek(size_t pos) final { position = pos; }
+        size_t Position() final { return position; }
+        size_t Size() final { return size; }
+
+        int ReadByte(){ return position < size ? memory.get()[position++] : -1; }
+
+        int ReadBytesUnlocked(uint8_t *ptr, int buffer_size) final {
+            auto read_bytes = min(buffer_size, Remaining());
+            if(read_bytes <= 0)
+                return 0;
+            memcpy(ptr, memory.get() + position, read_bytes);
+            position += read_bytes;
+            return read_bytes;
+        }
+
+        /**Overwrite the mapped bytes at the position. The map does not grow, so writes past the end are cut off**/
+        int WriteBytes(uint8_t *ptr, int nbytes) final {
+            if(!writable)
+                return 0;
+            nbytes = min(nbytes, Remaining());
+            if(nbytes <= 0)
+                return 0;
+            memcpy(memory.get() + position, ptr, nbytes);
+            position += nbytes;
+            return nbytes;
+        }
+
+        /**Read the raw memory of the io at the specified position**/
+        template<typename T = uint8_t> T* Interpret(size_t pos){ return (T*) (memory.get() + pos); }
+        /**Read the raw memory of the io at the current position**/
+        template<typename T = uint8_t> T* Interpret(){ return Interpret<T>(position); }
+
+        /**A packet sized view of $length bytes at $offset that points into the mapping (no copy) and keeps it alive**/
+        IOArray Slice(size_t offset, size_t length){ return IOArray(ref<uint8_t>(memory, memory.get() + offset), length, length); }
+
+        int WriteTo(IO& io){ return WriteTo(io, Remaining()); }
+        int WriteTo(IO& io, int count){
+            count = min(count, Remaining());
+            if(count <= 0)
+                return 0;
+            io.WriteBytes(Interpret(), count);
+            position += count;
+            return count;
+        }
+    };
+
+    /**Connection over a file descriptor IO (pipe, socket, tty). Fire reads whatever is available without blocking and
+     * hands it to Receive. Writes are flushed at the end of every message**/
+    struct FdConnection : public Connection{
+        FdIO& io;
+        Packet p;
+
+        explicit FdConnection(FdIO& io, int capacity = 256) : io(io), p(capacity){}
+
+        /**Read into a buffer from $pool (a heap buffer of $capacity when it is exhausted)**/
+        FdConnection(FdIO& io, PacketPool& pool, int capacity = 256) : io(io), p(pool.Take(capacity)){}
+
+        TaskReturn Fire() override{
+            int nbytes;
+            while(io.BytesAvailable() > 0 && (nbytes = io.ReadBytesUnlocked(p.Interpret(0), p.Capacity())) > 0){
+                Packet chunk(p.Slice(0, nbytes));
+                Receive(&chunk);
+            }
+            return TaskReturn::Nothing;
+        }
+    protected:
+        void Write(IO* in) override {
+            io.ReadFrom(*in);
+            io.Flush();
+        }
 
+        void WriteV(const Span* parts, int count) override {
+            io.WriteBytesV(parts, count);
+            io.Flush();
+        }
+    };
+
+    namespace Internal{
+#if defined(__linux__)
+        using Datagram = ::mmsghdr;
+
+        inline int ReceiveDatagrams(int fd, Datagram* msgs, int count){ return recvmmsg(fd, msgs, count, MSG_DONTWAIT, nullptr); }
+        inline int SendDatagrams(int fd, Datagram* msgs, int count){ return sendmmsg(fd, msgs, count, 0); }
+#else
+        struct Datagram{
+            msghdr msg_hdr;
+            unsigned int msg_len;
+        };
+
+        /**recvmmsg/sendmmsg are Linux only, take a syscall per datagram (same results)**/
+        inline int ReceiveDatagrams(int fd, Datagram* msgs, int count){
+            int i = 0;
+            for(; i < count; i++){
+                auto n = recvmsg(fd, &msgs[i].msg_hdr, MSG_DONTWAIT);
+                if(n < 0)
+                    return i > 0 ? i : -1;
+                msgs[i].msg_len = (unsigned int) n;
+            }
+            return i;
+        }
+
+        inline int SendDatagrams(int fd, Datagram* msgs, int count){
+            int i = 0;
+            for(; i < count; i++){
+                auto n = sendmsg(fd, &msgs[i].msg_hdr, 0);
+                if(n < 0)
+                    return i > 0 ? i : -1;
+                msgs[i].msg_len = (unsigned int) n;
+            }
+            return i;
+        }
+#endif
+    }
+
+    /**Address of a datagram socket peer (IPv4 or Unix domain)**/
+    struct SocketAddress{
+        sockaddr_storage storage;
+        socklen_t length = 0;
+
+        inline const sockaddr* Get() const { return (const sockaddr*) &storage; }
+        inline bool IsSet() const { return length > 0; }
+    };
+
+    /**Connection over a non blocking datagram socket. Every datagram is one message, so the framing of SimpleConnection is not needed.
+     * Fire takes up to $batch datagrams per recvmmsg and hands each to Receive as a slice of the receive buffers (no copy).
+     * Writes are queued with their destination and sent with one sendmmsg when $batch are queued, at the end of Fire or on Flush,
+     * so replies to a whole batch go out in one syscall. Datagrams bigger than $capacity bytes are dropped and, like UDP, none are guaranteed to arrive**/
+    struct DatagramConnection : public Connection{
+    protected:
+        int fd;
+    private:
+        int batch, capacity;
+        int queued = 0, current = -1;
+        size_t dropped = 0;
+        ref<uint8_t> rx, tx;
+        SocketAddress destination;
+        vector<SocketAddress> sources, destinations;
+        vector<Internal::Datagram> rx_headers, tx_headers;
+        vector<iovec> rx_parts, tx_parts;
+
+        /**Point the receive headers at $count fresh slots of $capacity bytes**/
+        void NewReceiveBuffers(){
+            rx.reset(new uint8_t[(size_t) batch * capacity], default_delete<uint8_t[]>());
+            for(int i = 0; i < batch; i++)
+                rx_parts[i] = {rx.get() + (size_t) i * capacity, (size_t) capacity};
+        }
+
+        /**Receive the waiting datagrams, up to a batch. Return how many**/
+        int ReceiveBatch(){
+            for(int i = 0; i < batch; i++){
+                auto& h = rx_headers[i].msg_hdr;
+                h = msghdr();
+                h.msg_name = &sources[i].storage;
+                h.msg_namelen = sizeof(sockaddr_storage);
+                h.msg_iov = &rx_parts[i];
+                h.msg_iovlen = 1;
+            }
+            int n;
+            while((n = Internal::ReceiveDatagrams(fd, rx_headers.data(), batch)) < 0 && errno == EINTR);
+            for(int i = 0; i < n; i++)
+                sources[i].length = rx_headers[i].msg_hdr.msg_namelen;
+            return max(n, 0);
+        }
+
+    public:
+        /**Take over the datagram socket $fd (closed with the connection) and make it non blocking**/
+        DatagramConnection(int fd, int batch = 32, int capacity = 2048)
+            : fd(fd), batch(max(batch, 1)), capacity(capacity), tx(new uint8_t[(size_t) max(batch, 1) * capacity], default_delete<uint8_t[]>()),
+              sources(this->batch), destinations(this->batch), rx_headers(this->batch), tx_headers(this->batch), rx_parts(this->batch), tx_parts(this->batch){
+            if(fd >= 0)
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            NewReceiveBuffers();
+        }
+
+        DatagramConnection(const DatagramConnection&) = delete;
+        DatagramConnection& operator=(const DatagramConnection&) = delete;
+
+        ~DatagramConnection() override { Close(); }
+
+        inline bool IsOpen() const { return fd >= 0; }
+
+        /**Send what is queued and close the socket**/
+        void Close(){
+            if(fd < 0)
+                return;
+            Flush();
+            close(fd);
+            fd = -1;
+        }
+
+        /**Send the following writes to $address. An unset address sends to the connected peer**/
+        void To(const SocketAddress& address){ destination = address; }
+
+        /**Address of the datagram being received. Only valid inside Receive, To(Sender()) replies to it**/
+        inline const SocketAddress& Sender() const { return sources[max(current, 0)]; }
+
+        /**Datagrams dropped because they were bigger than the capacity (received or written) or could not be sent**/
+        inline size_t Dropped() const { return dropped; }
+
+        inline int Queued() const { return queued; }
+
+        /**Hand every waiting datagram to Receive, a batch per syscall, then send what was queued meanwhile**/
+        TaskReturn Fire() override{
+            Flush();
+            int n;
+            do{
+                n = ReceiveBatch();
+                for(current = 0; current < n; current++){
+                    if(rx_headers[current].msg_hdr.msg_flags & MSG_TRUNC){
+                        dropped++;
+                        continue;
+                    }
+                    auto length = (int) rx_headers[current].msg_len;
+                    Packet datagram(IOArray(ref<uint8_t>(rx, rx.get() + (size_t) current * capacity), length, length));
+                    Receive(&datagram);
+                }
+                current = -1;
+                if(rx.use_count() > 1)
+                    NewReceiveBuffers();        //A received message was kept, do not overwrite it
+            }while(n == batch);
+            Flush();
+            return TaskReturn::Nothing;
+        }
+
+        /**Send the queued datagrams with as few syscalls as possible. Datagrams are best effort: when the socket is full (the peer
+         * does not read) the rest are dropped instead of waiting, which could wait forever on a peer served by the same loop.
+         * Return false if any were dropped**/
+        bool Flush(){
+            int sent = 0;
+            auto ok = true;
+            while(sent < queued){
+                auto n = Internal::SendDatagrams(fd, tx_headers.data() + sent, queued - sent);
+                if(n >= 0){
+                    sent += n;
+                    continue;
+                }
+                if(errno == EINTR)
+                    continue;
+                ok = false;
+                if(errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS){
+                    dropped += queued - sent;
+                    break;
+                }
+                dropped++;                      //Skip the datagram that failed (no route, too big, refused)
+                sent++;
+            }
+            queued = 0;
+            return ok;
+        }
+
+    protected:
+        /**Queue a datagram slot for the current destination. Flushes first when the queue is full**/
+        uint8_t* Queue(){
+            if(queued == batch)
+                Flush();
+            auto i = queued++;
+            destinations[i] = destination;
+            auto& h = tx_headers[i].msg_hdr;
+            h = msghdr();
+            h.msg_name = destination.IsSet() ? &destinations[i].storage : nullptr;
+            h.msg_namelen = destination.length;
+            h.msg_iov = &tx_parts[i];
+            h.msg_iovlen = 1;
+            tx_parts[i].iov_base = tx.get() + (size_t) i * capacity;
+            return (uint8_t*) tx_parts[i].iov_base;
+        }
+
+        /**A message bigger than the capacity is dropped (see Dropped) instead of being sent cut off**/
+        void Write(IO* in) override {
+            IOArray slot(ref<uint8_t>(tx, Queue()), capacity);
+            tx_parts[queued - 1].iov_len = slot.ReadFrom(*in);
+            if(in->BytesAvailable() > 0){
+                queued--;
+                dropped++;
+                return;
+            }
+            if(queued == batch)
+                Flush();
+        }
+
+        void WriteV(const Span* parts, int count) override {
+            int length = 0;
+            for(int i = 0; i < count; i++)
+                length += parts[i].length;
+            if(length > capacity){
+                dropped++;
+                return;
+            }
+            auto slot = Queue();
+            length = 0;
+            for(int i = 0; i < count; i++){
+                memcpy(slot + length, parts[i].data, parts[i].length);
+                length += parts[i].length;
+            }
+            tx_parts[queued - 1].iov_len = length;
+            if(queued == batch)
+                Flush();
+        }
+    };
+
+    /**UDP (IPv4) Connection. Binds to a port on every interface and sends to the address set with To (or the sender being replied to)
+     * Use it like this
+     *  struct Station : UdpConnection { void Receive(Packet* p) override { To(Sender()); Send(p); } };    //Echo
+     *  Station s(9000);
+     *  s.Start();
+     * **/
+    struct UdpConnection : public DatagramConnection{
+        /**Bind to $port (0 picks a free one, see Port)**/
+        explicit UdpConnection(uint16_t port = 0, int batch = 32, int capacity = 2048) : DatagramConnection(socket(AF_INET, SOCK_DGRAM, 0), batch, capacity){
+            sockaddr_in local = {};
+            local.sin_family = AF_INET;
+            local.sin_addr.s_addr = htonl(INADDR_ANY);
+            local.sin_port = htons(port);
+            if(IsOpen() && bind(fd, (sockaddr*) &local, sizeof(local)) != 0)
+                Close();
+        }
+
+        /**The port the socket is bound to**/
+        uint16_t Port() const {
+            sockaddr_in local = {};
+            socklen_t length = sizeof(local);
+            return IsOpen() && getsockname(fd, (sockaddr*) &local, &length) == 0 ? ntohs(local.sin_port) : 0;
+        }
+
+        /**The IPv4 address of $host (name or dotted) at $port. Unset when it does not resolve**/
+        static SocketAddress Resolve(const char* host, uint16_t port){
+            SocketAddress address;
+            addrinfo hints = {}, *found = nullptr;
+            hints.ai_family = AF_INET;
+            hints.ai_socktype = SOCK_DGRAM;
+            if(getaddrinfo(host, nullptr, &hints, &found) == 0 && found != nullptr){
+                memcpy(&address.storage, found->ai_addr, found->ai_addrlen);
+                address.length = found->ai_addrlen;
+                ((sockaddr_in*) &address.storage)->sin_port = htons(port);
+            }
+            if(found != nullptr)
+                freeaddrinfo(found);
+            return address;
+        }
+
+        using DatagramConnection::To;
+
+        /**Send the following writes to $host:$port. Return false when it does not resolve**/
+        bool To(const char* host, uint16_t port){
+            auto address = Resolve(host, port);
+            if(address.IsSet())
+                To(address);
+            return address.IsSet();
+        }
+    };
+
+    /**Unix domain datagram Connection for IPC between processes of one machine. Bound to a socket file that is removed with it**/
+    struct UnixSocketConnection : public DatagramConnection{
+    private:
+        string path;
+    public:
+        /**Bind to $path (replacing a stale socket file). nullptr leaves it unbound, it can send but not be replied to.
+         * Fails (see IsOpen) when $path is anything else or a socket that is still bound**/
+        explicit UnixSocketConnection(const char* path = nullptr, int batch = 32, int capacity = 2048) : DatagramConnection(socket(AF_UNIX, SOCK_DGRAM, 0), batch, capacity){
+            if(path == nullptr || !IsOpen())
+                return;
+            auto address = Address(path);
+            if(address.IsSet() && IsStale(address))
+                unlink(path);
+            if(!address.IsSet() || bind(fd, address.Get(), address.length) != 0)
+                Close();
+            else
+                this->path = path;
+        }
+
+        ~UnixSocketConnection() override {
+            if(!path.empty())
+                unlink(path.c_str());
+        }
+
+        /**If the socket file at $address is left over from a socket that is gone: connecting to it is refused**/
+        static bool IsStale(const SocketAddress& address){
+            struct stat st;
+            if(lstat(((const sockaddr_un*) &address.storage)->sun_path, &st) != 0 || !S_ISSOCK(st.st_mode))
+                return false;
+            int probe = socket(AF_UNIX, SOCK_DGRAM, 0);
+            if(probe < 0)
+                return false;
+            auto stale = connect(probe, address.Get(), address.length) != 0 && errno == ECONNREFUSED;
+            close(probe);
+            return stale;
+        }
+
+        /**The address of the socket file at $path. Unset when the path is too long**/
+        static SocketAddress Address(const char* path){
+            SocketAddress address;
+            auto& local = *(sockaddr_un*) &address.storage;
+            auto length = strlen(path);
+            if(length >= sizeof(local.sun_path))
+                return address;
+            local.sun_family = AF_UNIX;
+            memcpy(local.sun_path, path, length + 1);
+            address.length = (socklen_t) (offsetof(sockaddr_un, sun_path) + length + 1);
+            return address;
+        }
+
+        using DatagramConnection::To;
+
+        /**Send the following writes to the socket bound at $path. Return false when the path is too long**/
+        bool To(const char* path){
+            auto address = Address(path);
+            if(address.IsSet())
+                To(address);
+            return address.IsSet();
+        }
+    };
+}
+#endif
 
 #endif //SANDBOX_SIMPLEPC_H
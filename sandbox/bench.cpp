@@ -0,0 +1,956 @@
+/**********************************************************************
+   NAME: bench.cpp
+   AUTHOR: Johnathan Bizzano
+   DATE: 6/22/2023
+
+    The Simple Project
+		Medium Level (from Low) library that abstracts away from embedded device hardware
+
+    Simple Bench
+		Microbenchmarks of the hot paths. Every case is warmed up and calibrated to a fixed time per repetition,
+		then repeated to get min/median/mean/stddev in ns/op and bytes/s. Results can be written as JSON to compare releases
+
+		simple_bench [--filter text] [--repetitions n] [--json file|-]
+*********************************************************************/
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <string>
+#include "../devices/SimplePC.hpp"
+#include "../SimpleRPC.hpp"
+#include "../SimpleReliable.hpp"
+
+using namespace Simple;
+
+/**Keep the compiler from optimizing away a value that is only computed for the benchmark**/
+template<typename T> inline void Keep(const T& v){
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "g"(&v) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &v;
+#endif
+}
+
+struct BenchResult{
+    string group, name;
+    long iterations;
+    int repetitions;
+    double bytes, min, median, mean, stddev;
+};
+
+/**Runs, times and collects the benchmarks**/
+struct BenchSuite{
+    vector<BenchResult> results;
+    const char* filter = nullptr;
+    const char* group = "";
+    int repetitions = 9;
+    double repetition_ns = 2e6;         //Time each repetition is calibrated to take
+    FILE* table = stdout;
+    bool group_printed = false;
+
+    void Group(const char* name){
+        group = name;
+        group_printed = false;
+    }
+
+    /**If the benchmark $name of the current group passes the filter**/
+    bool Selected(const string& name) const { return filter == nullptr || (string(group) + "/" + name).find(filter) != string::npos; }
+
+    /**Time $f and record the ns per iteration. $bytes is the payload of one iteration (0 if it does not move bytes)**/
+    template<typename F> void Run(const string& name, double bytes, F f){
+        if(!Selected(name))
+            return;
+        if(!group_printed)
+            fprintf(table, "\n[%s]\n", group);
+        group_printed = true;
+
+        //Warm up (caches, branch predictors, lazy allocations) while doubling the iterations until they take a measurable time
+        long iterations = 1;
+        double ns;
+        while((ns = Time(iterations, f)) < repetition_ns / 8 && iterations < (1L << 30))
+            iterations *= 2;
+        iterations = max(1L, (long) (iterations * repetition_ns / max(ns, 1.0)));
+
+        vector<double> samples(repetitions);
+        for(auto& s : samples)
+            s = Time(iterations, f) / iterations;
+        sort(samples.begin(), samples.end());
+
+        BenchResult r{group, name, iterations, repetitions, bytes, samples.front(), samples[samples.size() / 2], 0, 0};
+        for(auto s : samples)
+            r.mean += s / samples.size();
+        for(auto s : samples)
+            r.stddev += (s - r.mean) * (s - r.mean) / samples.size();
+        r.stddev = sqrt(r.stddev);
+        results.push_back(r);
+
+        fprintf(table, "%-52s %12.1f ns/op  min %10.1f  +-%5.1f%%", name.c_str(), r.median, r.min, 100 * r.stddev / r.mean);
+        if(bytes > 0)
+            fprintf(table, " %10.1f MB/s", bytes * 1e3 / r.median);
+        fprintf(table, "\n");
+    }
+
+    void WriteJson(FILE* out){
+        fprintf(out, "{\n  \"suite\": \"simple_bench\",\n  \"compiler\": \"%s\",\n  \"repetitions\": %i,\n  \"results\": [\n", __VERSION__, repetitions);
+        for(size_t i = 0; i < results.size(); i++){
+            auto& r = results[i];
+            fprintf(out, "    {\"group\": \"%s\", \"name\": \"%s\", \"iterations\": %li, \"repetitions\": %i, "
+                         "\"ns_per_op\": {\"min\": %.3f, \"median\": %.3f, \"mean\": %.3f, \"stddev\": %.3f}, "
+                         "\"bytes_per_op\": %.0f, \"bytes_per_second\": %.0f}%s\n",
+                    r.group.c_str(), r.name.c_str(), r.iterations, r.repetitions, r.min, r.median, r.mean, r.stddev,
+                    r.bytes, r.bytes * 1e9 / r.median, i + 1 < results.size() ? "," : "");
+        }
+        fprintf(out, "  ]\n}\n");
+    }
+
+private:
+    template<typename F> static double Time(long iterations, F& f){
+        auto start = high_resolution_clock::now();
+        for(long i = 0; i < iterations; i++)
+            f();
+        return duration_cast<duration<double, nano>>(high_resolution_clock::now() - start).count();
+    }
+};
+
+/**The per element path that WriteStd/ReadStd used before the bulk path**/
+template<typename T> void WriteStdPerElement(IO& io, vector<T>& a){
+    io.WriteStd((uint32_t) a.size());
+    for(size_t i = 0; i < a.size(); i++)
+        io.WriteStd(a[i]);
+}
+
+template<typename T> void ReadStdPerElement(IO& io, vector<T>* a){
+    auto s = io.ReadStd<uint32_t>();
+    a->resize(s);
+    for(uint32_t i = 0; i < s; i++)
+        io.ReadStd<T>(&(*a)[i]);
+}
+
+/**The digit at a time, byte at a time Printf that IO used before the formatting kernel**/
+struct LegacyPrinter{
+    IO& io;
+
+    void PrintUInt64(char *buffer, uint64_t l) {
+        if (l == 0) {
+            io.WriteByte('0');
+            return;
+        }
+        int i = 0, k = 0, hl;
+        while (l > 0) {
+            buffer[i++] = (char) ('0' + (l % 10));
+            l /= 10;
+        }
+        for (hl = i / 2; k < hl; k++) {
+            int idx2 = i - k - 1;
+            char tmp = buffer[k];
+            buffer[k] = buffer[idx2];
+            buffer[idx2] = tmp;
+        }
+        buffer[i] = '\0';
+        io.WriteUnsafeString(buffer);
+    }
+
+    void PrintInt64(char *buffer, int64_t l) {
+        if (l < 0) {
+            io.WriteByte('-');
+            l *= -1;
+        }
+        PrintUInt64(buffer, (uint64_t) l);
+    }
+
+    void Printf(const char *fmt, ...) {
+        char buffer[24];
+        va_list args;
+        va_start(args, fmt);
+        while (*fmt != '\0') {
+            if (*fmt == '%') {
+                fmt++;
+                switch (*(fmt++)) {
+                    case 'i': PrintInt64(buffer, va_arg(args, int)); break;
+                    case 'u': PrintUInt64(buffer, va_arg(args, unsigned int)); break;
+                    case 'U': PrintUInt64(buffer, va_arg(args, unsigned long)); break;
+                    case 's': io.WriteUnsafeString(va_arg(args, char*)); break;
+                    default: io.WriteByte('%'); fmt--; break;
+                }
+            }else
+                io.WriteByte(*(fmt++));
+        }
+        va_end(args);
+    }
+};
+
+void BenchPrintf(BenchSuite& b){
+    IOArray io(256);
+    LegacyPrinter legacy{io};
+    char line[256];
+    FILE* null = fopen("/dev/null", "w");
+    FileIO file(null, nullptr);
+    LegacyPrinter legacy_file{file};
+
+    b.Group("Printf");
+    auto bytes = snprintf(line, sizeof(line), "Rx %i Pos:%i Cap:%u Val:%lu %s\r\n", -31313, 42, 256u, 9876543210UL, "ok");
+    b.Run("Printf IOArray legacy", bytes, [&]{ io.Clear(); legacy.Printf("Rx %i Pos:%i Cap:%u Val:%U %s\r\n", -31313, 42, 256u, 9876543210UL, "ok"); });
+    b.Run("Printf IOArray", bytes, [&]{ io.Clear(); io.Printf("Rx %i Pos:%i Cap:%u Val:%U %s\r\n", -31313, 42, 256u, 9876543210UL, "ok"); });
+    b.Run("Printf IOArray compile time format", bytes, [&]{ io.Clear(); io.Printf(SIMPLE_FORMAT("Rx %i Pos:%i Cap:%u Val:%U %s\r\n"), -31313, 42, 256u, 9876543210UL, "ok"); });
+    b.Run("snprintf", bytes, [&]{ Keep(snprintf(line, sizeof(line), "Rx %i Pos:%i Cap:%u Val:%lu %s\r\n", -31313, 42, 256u, 9876543210UL, "ok")); });
+    b.Run("Printf FileIO legacy", bytes, [&]{ legacy_file.Printf("Rx %i Pos:%i Cap:%u Val:%U %s\r\n", -31313, 42, 256u, 9876543210UL, "ok"); });
+    b.Run("Printf FileIO", bytes, [&]{ file.Printf("Rx %i Pos:%i Cap:%u Val:%U %s\r\n", -31313, 42, 256u, 9876543210UL, "ok"); });
+    b.Run("Printf FileIO compile time format", bytes, [&]{ file.Printf(SIMPLE_FORMAT("Rx %i Pos:%i Cap:%u Val:%U %s\r\n"), -31313, 42, 256u, 9876543210UL, "ok"); });
+    b.Run("fprintf", bytes, [&]{ fprintf(null, "Rx %i Pos:%i Cap:%u Val:%lu %s\r\n", -31313, 42, 256u, 9876543210UL, "ok"); });
+
+    b.Run("PrintUInt64 legacy", 20, [&]{ io.Clear(); legacy.PrintUInt64(line, 18446744073709551615ULL); });
+    b.Run("PrintUInt64", 20, [&]{ io.Clear(); io.PrintUInt64(line, 18446744073709551615ULL); });
+    fclose(null);
+}
+
+void BenchScalars(BenchSuite& b){
+    IOArray io(64);
+    uint32_t u = 0xC0FFEE;
+    double d = 3.25;
+    auto t = make_tuple(7, 1.5f, 2.25);
+
+    b.Group("Std");
+    b.Run("WriteStd uint32_t", sizeof(u), [&]{ io.Clear(); io.WriteStd(u); });
+    b.Run("WriteStd double", sizeof(d), [&]{ io.Clear(); io.WriteStd(d); });
+    b.Run("WriteStd tuple<int, float, double>", 16, [&]{ io.Clear(); io.WriteStd(t); });
+    io.Clear();
+    io.WriteStd(u);
+    b.Run("ReadStd uint32_t", sizeof(u), [&]{ io.SeekStart(); Keep(io.ReadStd<uint32_t>()); });
+    io.Clear();
+    io.WriteStd(d);
+    b.Run("ReadStd double", sizeof(d), [&]{ io.SeekStart(); Keep(io.ReadStd<double>()); });
+    io.Clear();
+    io.WriteStd(t);
+    b.Run("ReadStd tuple<int, float, double>", 16, [&]{ io.SeekStart(); Keep(io.ReadStd<tuple<int, float, double>>()); });
+}
+
+template<typename T> void BenchVector(BenchSuite& b, const char* type, int count){
+    vector<T> v(count), r;
+    for(int i = 0; i < count; i++)
+        v[i] = (T) (i * 3);
+    IOArray io(sizeof(uint32_t) + count * sizeof(T));
+    const double bytes = count * sizeof(T);
+    char name[64];
+
+    snprintf(name, sizeof(name), "WriteStd vector<%s>[%i] per element", type, count);
+    b.Run(name, bytes, [&]{ io.Clear(); WriteStdPerElement(io, v); });
+    snprintf(name, sizeof(name), "WriteStd vector<%s>[%i] bulk", type, count);
+    b.Run(name, bytes, [&]{ io.Clear(); io.WriteStd(v); });
+    snprintf(name, sizeof(name), "ReadStd vector<%s>[%i] per element", type, count);
+    b.Run(name, bytes, [&]{ io.SeekStart(); ReadStdPerElement(io, &r); });
+    snprintf(name, sizeof(name), "ReadStd vector<%s>[%i] bulk", type, count);
+    b.Run(name, bytes, [&]{ io.SeekStart(); io.ReadStd(&r); });
+
+    if(!r.empty() && r != v)
+        fprintf(stderr, "vector<%s> round trip failed!\n", type);
+}
+
+struct Sample{
+    uint32_t time;
+    float x, y, z;
+    int16_t temperature;
+};
+SIMPLE_SCHEMA(Sample, time, x, y, z, temperature)
+
+void BenchSchema(BenchSuite& b){
+    Sample s{1234, 1.5f, 2.5f, 3.5f, 27}, r;
+    IOArray io(64);
+    const double bytes = Sample_SimpleSchema::WireSize;
+
+    b.Run("WriteStd Sample field list", bytes, [&]{ io.Clear(); io.WriteStd(s.time, s.x, s.y, s.z, s.temperature); });
+    b.Run("WriteStd Sample schema", bytes, [&]{ io.Clear(); io.WriteStd(s); });
+    b.Run("ReadStd Sample field list", bytes, [&]{
+        io.SeekStart();
+        io.ReadStd(&r.time); io.ReadStd(&r.x); io.ReadStd(&r.y); io.ReadStd(&r.z); io.ReadStd(&r.temperature);
+    });
+    b.Run("ReadStd Sample schema", bytes, [&]{ io.SeekStart(); io.ReadStd(&r); });
+}
+
+/**Decode one varint a byte at a time, the way a plain LEB128 reader does**/
+inline int DecodeVarintByteLoop(const uint8_t* src, uint64_t* v){
+    uint64_t result = 0;
+    int i = 0;
+    uint8_t b;
+    do{
+        b = src[i];
+        result |= (uint64_t) (b & 0x7F) << (7 * i);
+        i++;
+    }while(b & 0x80);
+    *v = result;
+    return i;
+}
+
+template<typename T> void BenchCompact(BenchSuite& b, const char* type, const char* values, vector<T>& v){
+    IOArray io(sizeof(uint32_t) + v.size() * MaxVarintBytes);
+    vector<T> r;
+    const double bytes = v.size() * sizeof(T);
+    char name[96];
+
+    io.Clear();
+    io.WriteStd(v);
+    auto std_size = io.Size();
+    io.Clear();
+    io.WriteCompact(v);
+    auto compact_size = io.Size();
+    snprintf(name, sizeof(name), "WriteStd vector<%s> %s", type, values);
+    b.Run(name, bytes, [&]{ io.Clear(); io.WriteStd(v); });
+    if(b.Selected(name))
+        fprintf(b.table, "  vector<%s>[%i] %s: WriteStd %i bytes, WriteCompact %i bytes\n", type, (int) v.size(), values, (int) std_size, (int) compact_size);
+    snprintf(name, sizeof(name), "WriteCompact vector<%s> %s", type, values);
+    b.Run(name, bytes, [&]{ io.Clear(); io.WriteCompact(v); });
+    snprintf(name, sizeof(name), "ReadStd vector<%s> %s", type, values);
+    io.Clear();
+    io.WriteStd(v);
+    b.Run(name, bytes, [&]{ io.SeekStart(); io.ReadStd(&r); });
+    io.Clear();
+    io.WriteCompact(v);
+    snprintf(name, sizeof(name), "ReadCompact vector<%s> %s byte loop", type, values);
+    b.Run(name, bytes, [&]{
+        io.SeekStart();
+        auto p = io.Interpret();
+        uint64_t u;
+        p += DecodeVarintByteLoop(p, &u);
+        r.resize(u);
+        for(size_t i = 0; i < r.size(); i++){
+            p += DecodeVarintByteLoop(p, &u);
+            r[i] = is_signed<T>::value ? (T) UnZigZag(u) : (T) u;
+        }
+    });
+    snprintf(name, sizeof(name), "ReadCompact vector<%s> %s", type, values);
+    b.Run(name, bytes, [&]{ io.SeekStart(); io.ReadCompact(&r); });
+
+    if(!r.empty() && r != v)
+        fprintf(stderr, "vector<%s> compact round trip failed!\n", type);
+}
+
+void BenchCompact(BenchSuite& b){
+    vector<uint32_t> counters(4096);
+    vector<int16_t> deltas(4096);
+    vector<uint64_t> mixed(4096);
+    for(int i = 0; i < 4096; i++){
+        counters[i] = i % 1000;
+        deltas[i] = (int16_t) ((i * 37) % 201 - 100);
+        mixed[i] = ((uint64_t) i * 0x9E3779B97F4A7C15ULL) >> (8 + i % 56);
+    }
+    b.Group("Compact");
+    BenchCompact(b, "uint32_t", "counters < 1000", counters);
+    BenchCompact(b, "int16_t", "deltas +-100", deltas);
+    BenchCompact(b, "uint64_t", "mixed 1-8 byte values", mixed);
+}
+
+void BenchArena(BenchSuite& b){
+    vector<uint16_t> samples(32, 7);
+    vector<vector<int32_t>> rows(4, vector<int32_t>(8, -3));
+    IOArray io(1024);
+    io.WriteStd(samples);
+    io.WriteString("sensor-node-7");
+    io.WriteStd((uint32_t) rows.size());
+    for(auto& r : rows)
+        io.WriteStd(r);
+    const double bytes = io.Size();
+
+    vector<uint16_t> s;
+    vector<char> name;
+    vector<vector<int32_t>> r;
+    uint8_t memory[1024];
+    Arena arena(memory, sizeof(memory));
+    ArenaSpan<uint16_t> as;
+    ArenaSpan<char> aname;
+    ArenaSpan<ArenaSpan<int32_t>> ar;
+
+    b.Group("Arena");
+    b.Run("ReadStd message into std::vector (fresh)", bytes, [&]{
+        vector<uint16_t> s;
+        vector<char> name;
+        vector<vector<int32_t>> r;
+        io.SeekStart();
+        io.ReadStd(&s);
+        io.ReadStd(&name);
+        io.ReadStd(&r);
+        Keep(r);
+    });
+    b.Run("ReadStd message into std::vector (reused)", bytes, [&]{
+        io.SeekStart();
+        io.ReadStd(&s);
+        io.ReadStd(&name);
+        io.ReadStd(&r);
+    });
+    b.Run("ReadStd message into Arena", bytes, [&]{
+        io.SeekStart();
+        arena.Reset();
+        io.ReadStd(&as, arena);
+        io.ReadStd(&aname, arena);
+        io.ReadStd(&ar, arena);
+    });
+}
+
+void BenchViews(BenchSuite& b){
+    vector<float> readings(1000, 1.5f), r;
+    IOArray io(8192);
+    io.WriteStd((uint32_t) 42);
+    io.WriteStd(readings);
+    io.WriteString("sensor-node-7");
+    io.WriteStd((uint8_t) 3);
+    const double bytes = io.Size();
+    vector<char> name;
+
+    b.Group("Views");
+    b.Run("ReadStd 4 KB telemetry, read id + status", bytes, [&]{
+        io.SeekStart();
+        auto id = io.ReadStd<uint32_t>();
+        io.ReadStd(&r);
+        io.ReadStd(&name);
+        auto status = io.ReadStd<uint8_t>();
+        Keep(id);
+        Keep(status);
+    });
+    b.Run("ViewStd 4 KB telemetry, read id + status", bytes, [&]{
+        io.SeekStart();
+        auto id = io.ViewStd<uint32_t>();
+        io.ViewStdArray<float>();
+        io.ViewStdArray<char>();
+        auto status = io.ViewStd<uint8_t>();
+        Keep(id.Get());
+        Keep(status.Get());
+    });
+    b.Run("ViewStd 4 KB telemetry, read element 500", bytes, [&]{
+        io.SeekStart();
+        io.ViewStd<uint32_t>();
+        Keep(io.ViewStdArray<float>()[500]);
+    });
+}
+
+void BenchBuffers(BenchSuite& b){
+    const int count = 4096;
+    uint8_t chunk[16] = {};
+    IOArray array(count);
+    IOVector vector(count);
+    char name[64];
+
+    b.Group("Buffers");
+    snprintf(name, sizeof(name), "IOArray WriteBytes 16 B x %i", count / 16);
+    b.Run(name, count, [&]{ array.Clear(); for(int i = 0; i < count / 16; i++) array.WriteBytes(chunk, sizeof(chunk)); });
+    snprintf(name, sizeof(name), "IOVector WriteBytes 16 B x %i", count / 16);
+    b.Run(name, count, [&]{ vector.Clear(); for(int i = 0; i < count / 16; i++) vector.WriteBytes(chunk, sizeof(chunk)); });
+    snprintf(name, sizeof(name), "IOArray WriteByte x %i", count);
+    b.Run(name, count, [&]{ array.Clear(); for(int i = 0; i < count; i++) array.WriteByte((uint8_t) i); });
+    snprintf(name, sizeof(name), "IOVector WriteByte x %i", count);
+    b.Run(name, count, [&]{ vector.Clear(); for(int i = 0; i < count; i++) vector.WriteByte((uint8_t) i); });
+}
+
+/**The byte at a time ReadLine from before the delimiter scan**/
+int ReadLineBytewise(IO& io, SeekableIO& buffer){
+    auto pos = buffer.Position();
+    int c;
+    while((c = io.ReadByte()) >= 0 && c != '\n')
+        if(c != '\r')
+            buffer.WriteByte(c);
+    buffer.WriteByte('\0');
+    return pos;
+}
+
+void BenchPool(BenchSuite& b){
+    PacketPool pool(4, 256);
+
+    b.Run("Packet(256) per message, heap", 0, [&]{
+        Packet p(256);
+        p.WriteStd((uint32_t) 7);
+        Keep(p.Size());
+    });
+    b.Run("Packet(256) per message, PacketPool", 0, [&]{
+        Packet p(pool.Take(256));
+        p.WriteStd((uint32_t) 7);
+        Keep(p.Size());
+    });
+    if(pool.InUse() != 0 || pool.Exhausted() != 0)
+        fprintf(stderr, "PacketPool leaked %i buffers and was exhausted %zu times!\n", pool.InUse(), pool.Exhausted());
+}
+
+void BenchText(BenchSuite& b){
+    IOArray log(1 << 16);
+    char line[128];
+    for(int i = 0; log.Size() + sizeof(line) < log.Capacity(); i++)
+        log.WriteBytes((uint8_t*) line, snprintf(line, sizeof(line), "[%08i] node-%i temperature=%i.%i status=ok\r\n", i * 10, i % 7, 20 + i % 9, i % 10));
+    const double bytes = log.Size();
+    const int chunk = 1500;
+    IOVector out(256);
+    LineSplitter splitter;
+
+    b.Group("Text");
+    b.Run("ReadLine 64 KB log, byte at a time", bytes, [&]{
+        log.SeekStart();
+        while(log.BytesAvailable() > 0){
+            out.Clear();
+            ReadLineBytewise(log, out);
+        }
+        Keep(out.Size());
+    });
+    b.Run("ReadLine 64 KB log, delimiter scan", bytes, [&]{
+        log.SeekStart();
+        while(log.BytesAvailable() > 0){
+            out.Clear();
+            log.ReadLine(out);
+        }
+        Keep(out.Size());
+    });
+    b.Run("LineSplitter 64 KB log in 1500 B chunks", bytes, [&]{
+        int lines = 0;
+        for(int i = 0; i < (int) log.Size(); i += chunk)
+            lines += splitter.Feed(log.Interpret(i), min(chunk, (int) log.Size() - i), [](Span s){ Keep(s.length); });
+        Keep(lines);
+    });
+}
+
+void BenchChecksum(BenchSuite& b){
+    vector<uint8_t> data(4096);
+    for(size_t i = 0; i < data.size(); i++)
+        data[i] = (uint8_t) (i * 131 + 7);
+    const int bytes = data.size();
+
+    b.Group("Checksum");
+    b.Run("CRC32C 4 KB", bytes, [&]{ Keep(CRC32C::Compute(data.data(), bytes)); });
+    b.Run("CRC32C 4 KB slicing-by-8", bytes, [&]{ Keep(Internal::CRC32CSoftware(0xFFFFFFFF, data.data(), bytes)); });
+    b.Run("CRC16 4 KB", bytes, [&]{ Keep(CRC16::Compute(data.data(), bytes)); });
+}
+
+/**The stack buffer copy that IO::WriteTo used before the span path**/
+int WriteToBounce(IO& from, IO& to, int bytes){
+    uint8_t buffer[BUFSIZ];
+    int remaining = bytes;
+    while(remaining > 0 && from.BytesAvailable() > 0){
+        int read = from.ReadBytesUnlocked(buffer, min(BUFSIZ, remaining));
+        remaining -= read;
+        to.WriteBytes(buffer, read);
+    }
+    return bytes;
+}
+
+void BenchTransfer(BenchSuite& b, int count){
+    IOArray src(count);
+    IOVector vec(count);
+    RingIO ring(count);
+    src.SetSize(count);
+    char name[64];
+
+    snprintf(name, sizeof(name), "IOArray -> IOVector [%i] stack buffer", count);
+    b.Run(name, count, [&]{ src.SeekStart(); vec.Clear(); WriteToBounce(src, vec, count); });
+    snprintf(name, sizeof(name), "IOArray -> IOVector [%i] span", count);
+    b.Run(name, count, [&]{ src.SeekStart(); vec.Clear(); vec.ReadFrom((IO&) src); });
+    snprintf(name, sizeof(name), "IOArray -> RingIO [%i] stack buffer", count);
+    b.Run(name, count, [&]{ src.SeekStart(); ring.Clear(); WriteToBounce(src, ring, count); });
+    snprintf(name, sizeof(name), "IOArray -> RingIO [%i] span", count);
+    b.Run(name, count, [&]{ src.SeekStart(); ring.Clear(); ring.ReadFrom(src); });
+}
+
+/**Hands every frame straight to the peer's Receive, so a Send measures framing, parsing and delivery**/
+struct LoopbackConnection : public SimpleConnection{
+    LoopbackConnection* peer = nullptr;
+    Packet wire;
+    long received = 0;
+
+    explicit LoopbackConnection(int capacity = 256, FrameCheck check = FrameCheck::None, FrameLength length = FrameLength::Byte)
+        : SimpleConnection(capacity, check, length), wire(capacity){}
+
+    void Write(IO* io) override {
+        wire.Clear();
+        wire.ReadFrom(*io);
+        wire.SeekStart();
+        peer->Receive(&wire);
+    }
+
+    void ReceivedMessage(Packet* p) override { received++; }
+
+    TaskReturn Fire() override { return TaskReturn::Nothing; }
+};
+
+void BenchConnection(BenchSuite& b){
+    LoopbackConnection tx, rx;
+    tx.peer = &rx;
+    rx.peer = &tx;
+    long sent = 0;
+    char name[64];
+
+    b.Group("Connection");
+    for(int size : {16, 200}){
+        Packet p(size);
+        p.SetSize(size);
+        snprintf(name, sizeof(name), "SimpleConnection Send -> Receive %i B", size);
+        b.Run(name, size, [&]{ p.SeekStart(); tx.Send(&p); sent++; });
+    }
+    LoopbackConnection crc_tx(256, FrameCheck::CRC32C), crc_rx(256, FrameCheck::CRC32C);
+    crc_tx.peer = &crc_rx;
+    crc_rx.peer = &crc_tx;
+    for(int size : {16, 200}){
+        Packet p(size);
+        p.SetSize(size);
+        snprintf(name, sizeof(name), "SimpleConnection Send -> Receive %i B CRC32C", size);
+        b.Run(name, size, [&]{ p.SeekStart(); crc_tx.Send(&p); sent++; });
+    }
+    LoopbackConnection big_tx(8192, FrameCheck::CRC32C, FrameLength::Varint), big_rx(8192, FrameCheck::CRC32C, FrameLength::Varint);
+    big_tx.peer = &big_rx;
+    big_rx.peer = &big_tx;
+    Packet telemetry(4096);
+    telemetry.SetSize(4096);
+    b.Run("SimpleConnection Send -> Receive 4 KB CRC32C varint length", telemetry.Size(), [&]{ telemetry.SeekStart(); big_tx.Send(&telemetry); sent++; });
+    //The same 64 frames arriving in chunks of different sizes. The parser keeps its state, so the cost per frame should not change
+    LoopbackConnection recorder(4096), parser(4096);
+    Packet recorded(4096), message(32);
+    message.SetSize(32);
+    recorder.peer = &parser;
+    for(int i = 0; i < 64; i++){
+        message.SeekStart();
+        recorder.Send(&message);
+        recorded.WriteBytes(recorder.wire.Interpret(0), recorder.wire.Size());
+    }
+    parser.received = 0;
+    long parsed = 0;
+    for(int chunk : {4096, 64, 1}){
+        snprintf(name, sizeof(name), "SimpleConnection Receive 64 x 32 B frames in %i B chunks", chunk);
+        b.Run(name, recorded.Size(), [&]{
+            for(int i = 0; i < (int) recorded.Size(); i += chunk){
+                Packet piece(recorded.Slice(i, min(chunk, (int) recorded.Size() - i)));
+                parser.Receive(&piece);
+            }
+            parsed += 64;
+        });
+    }
+    if(parser.received != parsed)
+        fprintf(stderr, "SimpleConnection parsed %li of %li frames!\n", parser.received, parsed);
+
+    //A control loop tick: 16 small status messages, one write each or coalesced into one frame
+    LoopbackConnection tick_tx(1024), tick_rx(1024), batch_tx(1024), batch_rx(1024);
+    tick_tx.peer = &tick_rx;
+    batch_tx.peer = &batch_rx;
+    batch_tx.Coalesce(240);
+    Packet status(8);
+    status.SetSize(8);
+    long batched = 0;
+    b.Run("SimpleConnection 16 x 8 B messages", 16 * 8, [&]{ for(int i = 0; i < 16; i++){ status.SeekStart(); tick_tx.Send(&status); } });
+    b.Run("SimpleConnection 16 x 8 B messages coalesced", 16 * 8, [&]{
+        for(int i = 0; i < 16; i++){
+            status.SeekStart();
+            batch_tx.Send(&status);
+        }
+        batch_tx.Flush();
+        batched += 16;
+    });
+    if(batch_rx.received != batched)
+        fprintf(stderr, "SimpleConnection coalesced %li messages but delivered %li!\n", batched, batch_rx.received);
+    if(rx.received + crc_rx.received + big_rx.received != sent)
+        fprintf(stderr, "SimpleConnection lost %li of %li frames!\n", sent - rx.received - crc_rx.received - big_rx.received, sent);
+
+    //A noisy line: a frame behind 1 KB of junk that has to be skipped to find the magic number
+    LoopbackConnection noisy(2048);
+    Packet line(1100);
+    for(int i = 0; i < 1024; i++)
+        line.WriteByte((uint8_t) (i * 7 + 1) == 0xDE ? 0 : (uint8_t) (i * 7 + 1));
+    uint8_t frame[sizeof(MAGIC_NUMBER) + 1 + 16 + 1] = {};
+    StoreStd(frame, MAGIC_NUMBER);
+    frame[sizeof(MAGIC_NUMBER)] = 16;
+    frame[sizeof(frame) - 1] = TAIL_MAGIC_NUMBER;
+    line.WriteBytes(frame, sizeof(frame));
+    long noisy_sent = 0;
+    b.Run("SimpleConnection Receive 16 B behind 1 KB junk", line.Size(), [&]{ line.SeekStart(); noisy.Receive(&line); noisy_sent++; });
+    if(noisy.received != noisy_sent)
+        fprintf(stderr, "SimpleConnection lost %li of %li frames behind junk!\n", noisy_sent - noisy.received, noisy_sent);
+}
+
+/**A telemetry record as the radio links send it (text, so most of it repeats from record to record)**/
+int TelemetryRecord(char* dst, int size, int i){
+    return snprintf(dst, size, "t=%06i alt=%07.2f vx=%+.3f vy=%+.3f temp=%04.1f batt=%.2f\n",
+                    i * 20, 150 + i * 0.25, (i % 17) * 0.013, -(i % 5) * 0.007, 21 + (i % 9) * 0.1, 3.9 - (i % 50) * 0.001);
+}
+
+void BenchCompression(BenchSuite& b){
+    //What the records share, given to both ends ahead of time
+    static const char dictionary[] = "t=000000 alt=0000.00 vx=+0.000 vy=-0.000 temp=00.0 batt=3.90\nt=0 alt=1 vx=+0.0 vy=-0.0 temp=2 batt=3.8";
+    Compressor plain, preset((const uint8_t*) dictionary, sizeof(dictionary) - 1);
+    char record[128], name[96];
+    int length = TelemetryRecord(record, sizeof(record), 42);
+
+    //A batch of records (coalesced or logged) compresses well on its own, a single record needs the dictionary
+    vector<uint8_t> batch;
+    for(int i = 0; i < 32; i++){
+        char r[128];
+        int n = TelemetryRecord(r, sizeof(r), i);
+        batch.insert(batch.end(), r, r + n);
+    }
+
+    vector<uint8_t> packed(Compressor::Bound(batch.size())), unpacked(batch.size());
+    b.Group("Compression");
+    struct Case{ const char* name; Compressor* lz; const uint8_t* data; int length; };
+    Case cases[] = {{"1 record", &plain, (const uint8_t*) record, length}, {"1 record dictionary", &preset, (const uint8_t*) record, length},
+                    {"32 records", &plain, batch.data(), (int) batch.size()}, {"32 records dictionary", &preset, batch.data(), (int) batch.size()}};
+    for(auto& c : cases){
+        int n = c.lz->Compress(c.data, c.length, packed.data(), packed.size());
+        snprintf(name, sizeof(name), "LZ4 compress %s (%i B)", c.name, c.length);
+        b.Run(name, c.length, [&]{ Keep(c.lz->Compress(c.data, c.length, packed.data(), packed.size())); });
+        snprintf(name, sizeof(name), "LZ4 decompress %s (%i B)", c.name, c.length);
+        b.Run(name, c.length, [&]{ Keep(c.lz->Decompress(packed.data(), n, unpacked.data(), unpacked.size())); });
+        if(b.Selected(string("LZ4 ratio ") + c.name))
+            fprintf(b.table, "LZ4 ratio %-46s %4i B -> %4i B  %.2f\n", c.name, c.length, n, (double) n / c.length);
+        if(c.lz->Decompress(packed.data(), n, unpacked.data(), unpacked.size()) != c.length || memcmp(unpacked.data(), c.data, c.length) != 0)
+            fprintf(stderr, "LZ4 %s did not decompress to its input!\n", c.name);
+    }
+
+    //The whole path: compress, frame, parse, decompress
+    LoopbackConnection tx(512), rx(512);
+    tx.peer = &rx;
+    tx.Compress(&preset);
+    rx.Compress(&preset);
+    Packet p(length);
+    p.WriteBytes((uint8_t*) record, length);
+    long sent = 0;
+    b.Run("SimpleConnection Send -> Receive 1 record compressed", length, [&]{ p.SeekStart(); tx.Send(&p); sent++; });
+    if(rx.received != sent || rx.CorruptFrames() != 0)
+        fprintf(stderr, "SimpleConnection lost compressed frames!\n");
+}
+
+#ifdef SIMPLE_POSIX
+struct CountingSocket : public UdpConnection{
+    long received = 0;
+    using UdpConnection::UdpConnection;
+    void Receive(Packet* p) override { received++; }
+};
+
+/**A burst of datagrams from many nodes: one syscall per datagram against recvmmsg/sendmmsg batches**/
+void BenchDatagrams(BenchSuite& b){
+    char name[96];
+    Packet p(64);
+    p.SetSize(64);
+
+    b.Group("Datagram");
+    for(int batch : {1, 32}){
+        CountingSocket rx(0, batch), tx(0, batch);
+        tx.To("127.0.0.1", rx.Port());
+        long sent = 0;
+        snprintf(name, sizeof(name), "UDP loopback 32 x 64 B datagrams, batch %i", batch);
+        b.Run(name, 32 * 64, [&]{
+            for(int i = 0; i < 32; i++){
+                p.SeekStart();
+                tx.Send(&p);
+            }
+            tx.Flush();
+            rx.Fire();
+            sent += 32;
+        });
+        if(rx.received != sent || tx.Dropped() != 0)
+            fprintf(stderr, "UDP received %li of %li datagrams!\n", rx.received, sent);
+    }
+}
+#endif
+
+using SetLed = Message<1, uint8_t, bool>;
+using Telemetry = Message<2, float, float, int32_t>;
+using Heartbeat = Message<3, uint32_t>;
+
+/**Decoding a received message and calling its handler: the Dispatcher table against a hand written switch**/
+void BenchDispatch(BenchSuite& b){
+    LoopbackConnection tx;
+    Dispatcher<4> rpc(tx);
+    float sum = 0;
+    make_local_lambda(set_led, [&], void, (uint8_t led, bool on), sum += on ? led : 0);
+    make_local_lambda(telemetry, [&], void, (float x, float y, int32_t t), sum += x + y + t);
+    make_local_lambda(heartbeat, [&], void, (uint32_t n), sum += n);
+    rpc.On<SetLed>(set_led);
+    rpc.On<Telemetry>(telemetry);
+    rpc.On<Heartbeat>(heartbeat);
+
+    Packet message(32);
+    message.WriteStd(Telemetry::ID);
+    message.WriteStd(Telemetry::Args(1.5f, 2.5f, 7));
+
+    b.Group("Dispatch");
+    b.Run("Dispatcher Telemetry (3 arguments)", message.Size(), [&]{ message.SeekStart(); rpc.Dispatch(&message); Keep(sum); });
+    b.Run("switch + ReadStd Telemetry (3 arguments)", message.Size(), [&]{
+        message.SeekStart();
+        switch(message.ReadStd<uint8_t>()){
+            case SetLed::ID: message.ReadStd(set_led); break;
+            case Telemetry::ID: message.ReadStd(telemetry); break;
+            case Heartbeat::ID: message.ReadStd(heartbeat); break;
+        }
+        Keep(sum);
+    });
+    if(rpc.Unhandled() != 0)
+        fprintf(stderr, "Dispatcher did not handle %zu messages!\n", rpc.Unhandled());
+}
+
+/**A radio like link: every frame arrives $delay ms later, or is lost with a probability of 1 / $loss**/
+struct LossyLink : public ReliableConnection{
+    struct Flight{
+        LossyLink* to;
+        time_t due;
+        vector<uint8_t> frame;
+    };
+    static deque<Flight> air;
+    static uint32_t noise;
+    LossyLink* peer = nullptr;
+    int delay, loss;
+    long received = 0;
+
+    LossyLink(int window, int delay, int loss) : ReliableConnection(window), delay(delay), loss(loss){ SetTimeout(4 * delay, 2); }
+
+    void Write(IO* io) override {
+        noise = noise * 1664525 + 1013904223;
+        if((noise >> 8) % loss == 0)
+            return;
+        Flight f{peer, NativeMillis() + delay, vector<uint8_t>(io->BytesAvailable())};
+        io->ReadBytesUnlocked(f.frame.data(), f.frame.size());
+        air.push_back(std::move(f));
+    }
+
+    void ReceivedMessage(Packet* p) override { received++; }
+
+    /**Run the timers and land the frames that are due**/
+    static void Pump(){
+        Task::Yield();
+        auto now = NativeMillis();
+        while(!air.empty() && air.front().due <= now){
+            auto f = std::move(air.front());
+            air.pop_front();
+            Packet p(f.frame.size());
+            p.WriteBytes(f.frame.data(), f.frame.size());
+            p.SeekStart();
+            f.to->Receive(&p);
+        }
+    }
+};
+
+deque<LossyLink::Flight> LossyLink::air;
+uint32_t LossyLink::noise = 1;
+
+/**Messages over a link with a 4 ms round trip that loses 1 in 20 frames: stop and wait against a window of messages in flight**/
+void BenchReliable(BenchSuite& b){
+    char name[96];
+    Packet p(32);
+    p.SetSize(32);
+
+    b.Group("Reliable");
+    for(int window : {1, 8, 32}){
+        LossyLink tx(window, 2, 20), rx(window, 2, 20);
+        tx.peer = &rx;
+        rx.peer = &tx;
+        long sent = 0;
+        snprintf(name, sizeof(name), "ReliableConnection 32 x 32 B messages delivered, window %i", window);
+        b.Run(name, 32 * 32, [&]{
+            for(int i = 0; i < 32; i++){
+                p.SeekStart();
+                while(!tx.TrySend(&p))
+                    LossyLink::Pump();
+            }
+            while(tx.InFlight() > 0)
+                LossyLink::Pump();
+            sent += 32;
+        });
+        LossyLink::air.clear();
+        if(rx.received != sent)
+            fprintf(stderr, "ReliableConnection delivered %li of %li messages!\n", rx.received, sent);
+    }
+}
+
+struct CountingTask : public Task{
+    long fired = 0;
+    TaskReturn Fire() override {
+        fired++;
+        return TaskReturn::Nothing;
+    }
+};
+
+void BenchTasks(BenchSuite& b){
+    char name[64];
+
+    b.Group("Tasks");
+    for(int n : {1, 16, 256}){
+        vector<CountingTask> tasks(n);
+        for(auto& t : tasks)
+            t.Start();
+        snprintf(name, sizeof(name), "Task::Yield %i tasks", n);
+        b.Run(name, 0, []{ Task::Yield(); });
+        for(auto& t : tasks)
+            t.Stop();
+    }
+
+    long fired = 0;
+    auto callback = make_global_lambda([&], void, (Timer& t), fired++);
+    Timer due(true, 0, callback), idle(true, 1000000, callback);
+    due.Start();
+    b.Run("Timer fire (due every Yield)", 0, []{ Task::Yield(); });
+    due.Stop();
+    idle.Start();
+    b.Run("Timer poll (not due)", 0, []{ Task::Yield(); });
+    idle.Stop();
+    Keep(fired);
+}
+
+int AddFunction(int x){ return x + 1; }
+
+void BenchLambda(BenchSuite& b){
+    int k = 1, acc = 0;
+    auto global = make_global_lambda([&], int, (int x), return x + k);
+    make_local_lambda(local, [&], int, (int x), return x + k);
+    auto stat = make_static_lambda(int, (int x), return x + 1);
+    std::function<int(int)> function = [&](int x){ return x + k; };
+    int (* volatile pointer)(int) = AddFunction;
+
+    b.Group("Lambda");
+    b.Run("Lambda global", 0, [&]{ acc = global(acc); Keep(acc); });
+    b.Run("Lambda local", 0, [&]{ acc = local(acc); Keep(acc); });
+    b.Run("Lambda static", 0, [&]{ acc = stat(acc); Keep(acc); });
+    b.Run("std::function", 0, [&]{ acc = function(acc); Keep(acc); });
+    b.Run("function pointer", 0, [&]{ acc = pointer(acc); Keep(acc); });
+}
+
+int main(int argc, char** argv){
+    BenchSuite b;
+    const char* json = nullptr;
+    for(int i = 1; i + 1 < argc; i += 2){
+        if(strcmp(argv[i], "--filter") == 0)
+            b.filter = argv[i + 1];
+        else if(strcmp(argv[i], "--repetitions") == 0)
+            b.repetitions = max(1, atoi(argv[i + 1]));
+        else if(strcmp(argv[i], "--json") == 0)
+            json = argv[i + 1];
+    }
+    bool json_stdout = json != nullptr && strcmp(json, "-") == 0;
+    if(json_stdout)
+        b.table = stderr;
+
+    BenchScalars(b);
+    BenchVector<uint16_t>(b, "uint16_t", 4096);
+    BenchVector<float>(b, "float", 4096);
+    BenchVector<double>(b, "double", 4096);
+    BenchSchema(b);
+    BenchCompact(b);
+    BenchArena(b);
+    BenchViews(b);
+    BenchBuffers(b);
+    BenchPool(b);
+    BenchText(b);
+    BenchChecksum(b);
+    b.Group("Transfer");
+    BenchTransfer(b, 256);
+    BenchTransfer(b, 4096);
+    BenchPrintf(b);
+    BenchConnection(b);
+    BenchCompression(b);
+#ifdef SIMPLE_POSIX
+    BenchDatagrams(b);
+#endif
+    BenchDispatch(b);
+    BenchReliable(b);
+    BenchTasks(b);
+    BenchLambda(b);
+
+    if(json != nullptr){
+        auto out = json_stdout ? stdout : fopen(json, "w");
+        if(out == nullptr){
+            fprintf(stderr, "Unable to open %s\n", json);
+            return 1;
+        }
+        b.WriteJson(out);
+        if(!json_stdout)
+            fclose(out);
+    }
+}